@@ -0,0 +1,309 @@
+/*------------------------------------------------------------------------*/
+/*! \file bench.cpp
+    \brief benchmark harness running the checker on generated proofs
+
+  Generates the proofs of a fixed suite with 'generate', checks each of
+  them with the checker and reports wall and process time, peak resident
+  set size, throughput in rules and monomial products per second and the
+  time spent per rule type, taken from the final statistics of the
+  checker. The results are written as JSON, one object per benchmark, so
+  runs of different commits can be compared.
+
+  Part of Pacheck 3.0 : PAC proof checker.
+*/
+/*------------------------------------------------------------------------*/
+#include <sys/resource.h>
+#include <sys/wait.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+/*------------------------------------------------------------------------*/
+
+struct Benchmark {
+  const char* name;
+  std::vector<std::string> generator_args;
+};
+
+/// sized to run in well under a minute altogether
+static const std::vector<Benchmark> suite = {
+    {"multiplier-8", {"--shape", "multiplier", "--bits", "8"}},
+    {"multiplier-12", {"--shape", "multiplier", "--bits", "12"}},
+    {"multiplier-16", {"--shape", "multiplier", "--bits", "16"}},
+    {"multiplier-8-prime", {"--shape", "multiplier", "--bits", "8", "--modulus", "2147483647"}},
+    {"multiplier-6-depth-3", {"--shape", "multiplier", "--bits", "6", "--depth", "3"}},
+    {"random-sparse", {"--variables", "64", "--terms", "10", "--degree", "3", "--rules", "3000"}},
+    {"random-dense", {"--terms", "100", "--degree", "6", "--rules", "300"}},
+    {"random-wide", {"--antecedents", "12", "--rules", "500"}},
+    {"random-depth-6", {"--rules", "40", "--depth", "6"}},
+};
+
+static const char* const rule_kinds[] = {"axiom", "linear combination", "delete", "root",
+                                         "branch"};
+const int num_rule_kinds = 5;
+
+struct Result {
+  bool ok = false;
+  double seconds = 0;      // wall clock
+  double cpu_seconds = 0;  // user and system time of the checker
+  long peak_rss_kb = 0;
+  long rules = 0;
+  long monomial_products = 0;
+  double rule_seconds[num_rule_kinds] = {};
+};
+
+struct Options {
+  std::string checker = "./pacheck";
+  std::string generator = "./bench/generate";
+  std::string output;  // standard output if empty
+  std::string label;
+  std::string only;    // runs the benchmarks whose name contains it
+  int repeat = 1;
+  std::vector<std::string> checker_args;
+};
+
+static void usage() {
+  std::cerr << "usage: bench [ <option> ... ] [ -- <checker option> ... ]\n"
+            << "  --checker PATH    checker to run (default ./pacheck)\n"
+            << "  --generator PATH  proof generator (default ./bench/generate)\n"
+            << "  --output FILE     write the JSON report to FILE\n"
+            << "  --label TEXT      recorded in the report, e.g. the commit\n"
+            << "  --only TEXT       only runs benchmarks whose name contains TEXT\n"
+            << "  --repeat N        reports the fastest of N runs (default 1)\n";
+}
+
+static bool parseOptions(int argc, char* argv[], Options& options) {
+  for (int i = 1; i < argc; ++i) {
+    const std::string arg = argv[i];
+    if (arg == "--") {
+      options.checker_args.assign(argv + i + 1, argv + argc);
+      break;
+    }
+    if (i + 1 == argc) return false;
+    const char* value = argv[++i];
+    if (arg == "--checker") options.checker = value;
+    else if (arg == "--generator") options.generator = value;
+    else if (arg == "--output") options.output = value;
+    else if (arg == "--label") options.label = value;
+    else if (arg == "--only") options.only = value;
+    else if (arg == "--repeat") options.repeat = std::max(1, atoi(value));
+    else return false;
+  }
+  return true;
+}
+/*------------------------------------------------------------------------*/
+
+/// runs 'args' with standard output and error redirected to 'output',
+/// returns the exit status, or -1 if it did not exit normally
+static int run(const std::vector<std::string>& args, const std::string& output,
+               struct rusage& usage) {
+  const pid_t pid = fork();
+  if (pid < 0) return -1;
+  if (!pid) {
+    const int fd = open(output.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0) _exit(127);
+    dup2(fd, 1);
+    dup2(fd, 2);
+    close(fd);
+    std::vector<char*> argv;
+    for (const std::string& arg : args) argv.push_back(const_cast<char*>(arg.c_str()));
+    argv.push_back(nullptr);
+    execv(argv[0], argv.data());
+    _exit(127);
+  }
+  int status;
+  if (wait4(pid, &status, 0, &usage) != pid) return -1;
+  return WIFEXITED(status) ? WEXITSTATUS(status) : -1;
+}
+
+/// runs the generator, writing the proof to 'path'
+static bool generate(const Options& options, const Benchmark& benchmark, const std::string& path) {
+  const pid_t pid = fork();
+  if (pid < 0) return false;
+  if (!pid) {
+    const int fd = open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0) _exit(127);
+    dup2(fd, 1);
+    close(fd);
+    std::vector<char*> argv{const_cast<char*>(options.generator.c_str())};
+    for (const std::string& arg : benchmark.generator_args) {
+      argv.push_back(const_cast<char*>(arg.c_str()));
+    }
+    argv.push_back(nullptr);
+    execv(argv[0], argv.data());
+    _exit(127);
+  }
+  int status;
+  return waitpid(pid, &status, 0) == pid && WIFEXITED(status) && !WEXITSTATUS(status);
+}
+
+/// the number following 'key' in 'line', if it occurs
+static bool numberAfter(const std::string& line, const std::string& key, double& value) {
+  const size_t pos = line.find(key);
+  if (pos == std::string::npos) return false;
+  value = strtod(line.c_str() + pos + key.size(), nullptr);
+  return true;
+}
+
+/// picks the counters from the final statistics of the checker
+static void parseStatistics(const std::string& path, Result& result) {
+  std::ifstream in(path);
+  std::string line;
+  double value;
+  while (std::getline(in, line)) {
+    if (line.find("rules processed: ") != std::string::npos) {
+      numberAfter(line, ": ", value);
+      result.rules += static_cast<long>(value);
+    } else if (line.find("Time per rule type: ") != std::string::npos) {
+      for (int k = 0; k < num_rule_kinds; ++k) {
+        if (numberAfter(line, std::string(k ? ", " : ": ") + rule_kinds[k] + " ", value)) {
+          result.rule_seconds[k] = value;
+        }
+      }
+    } else if (numberAfter(line, "Monomial products formed: ", value)) {
+      result.monomial_products = static_cast<long>(value);
+    } else if (line == "Proof check completed successfully.") {
+      result.ok = true;
+    }
+  }
+}
+
+static Result check(const Options& options, const std::string& proof, const std::string& output) {
+  std::vector<std::string> args{options.checker};
+  args.insert(args.end(), options.checker_args.begin(), options.checker_args.end());
+  args.push_back(proof);
+
+  Result best;
+  for (int i = 0; i < options.repeat; ++i) {
+    Result result;
+    struct rusage usage;
+    const auto start = std::chrono::steady_clock::now();
+    const int status = run(args, output, usage);
+    const std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+    result.seconds = elapsed.count();
+    result.cpu_seconds = usage.ru_utime.tv_sec + 1e-6 * usage.ru_utime.tv_usec +
+                         usage.ru_stime.tv_sec + 1e-6 * usage.ru_stime.tv_usec;
+    result.peak_rss_kb = usage.ru_maxrss;
+    if (!status) parseStatistics(output, result);
+    if (!result.ok) return result;
+    if (!i || result.seconds < best.seconds) best = result;
+  }
+  return best;
+}
+/*------------------------------------------------------------------------*/
+// Report
+
+static std::string quoted(const std::string& s) {
+  std::string result = "\"";
+  for (char c : s) {
+    if (c == '"' || c == '\\') result += '\\';
+    result += c;
+  }
+  return result + "\"";
+}
+
+static std::string joined(const std::vector<std::string>& args) {
+  std::string result;
+  for (const std::string& arg : args) result += (result.empty() ? "" : " ") + arg;
+  return result;
+}
+
+static double rate(double count, double seconds) { return seconds > 0 ? count / seconds : 0; }
+
+static void report(std::ostream& out, const Benchmark& benchmark, long proof_bytes,
+                   const Result& result, bool last) {
+  out << "    {\n"
+      << "      \"name\": " << quoted(benchmark.name) << ",\n"
+      << "      \"generator_args\": " << quoted(joined(benchmark.generator_args)) << ",\n"
+      << "      \"proof_bytes\": " << proof_bytes << ",\n"
+      << "      \"status\": \"" << (result.ok ? "ok" : "failed") << "\",\n"
+      << "      \"rules\": " << result.rules << ",\n"
+      << "      \"seconds\": " << result.seconds << ",\n"
+      << "      \"cpu_seconds\": " << result.cpu_seconds << ",\n"
+      << "      \"peak_rss_kb\": " << result.peak_rss_kb << ",\n"
+      << "      \"rules_per_second\": " << rate(result.rules, result.seconds) << ",\n"
+      << "      \"monomial_products\": " << result.monomial_products << ",\n"
+      << "      \"monomials_per_second\": " << rate(result.monomial_products, result.seconds)
+      << ",\n"
+      << "      \"rule_seconds\": {";
+  for (int k = 0; k < num_rule_kinds; ++k) {
+    std::string key = rule_kinds[k];
+    std::replace(key.begin(), key.end(), ' ', '_');
+    out << (k ? ", " : "") << quoted(key) << ": " << result.rule_seconds[k];
+  }
+  out << "}\n    }" << (last ? "" : ",") << "\n";
+}
+/*------------------------------------------------------------------------*/
+
+int main(int argc, char* argv[]) {
+  Options options;
+  if (!parseOptions(argc, argv, options)) {
+    usage();
+    return 1;
+  }
+  char directory[] = "/tmp/pacheck-bench-XXXXXX";
+  if (!mkdtemp(directory)) {
+    perror("bench: cannot create temporary directory");
+    return 1;
+  }
+
+  std::vector<const Benchmark*> selected;
+  for (const Benchmark& benchmark : suite) {
+    if (strstr(benchmark.name, options.only.c_str())) selected.push_back(&benchmark);
+  }
+
+  std::ostringstream json;
+  json << "{\n"
+       << "  \"label\": " << quoted(options.label) << ",\n"
+       << "  \"checker\": " << quoted(options.checker) << ",\n"
+       << "  \"checker_args\": " << quoted(joined(options.checker_args)) << ",\n"
+       << "  \"benchmarks\": [\n";
+  fprintf(stderr, "%-22s %10s %9s %9s %12s %14s\n", "benchmark", "rules", "seconds", "RSS MB",
+          "rules/s", "monomials/s");
+  bool failed = false;
+  for (const Benchmark* benchmark : selected) {
+    const std::string proof = std::string(directory) + "/" + benchmark->name + ".proof";
+    const std::string output = std::string(directory) + "/" + benchmark->name + ".out";
+    Result result;
+    long proof_bytes = 0;
+    if (generate(options, *benchmark, proof)) {
+      std::ifstream in(proof, std::ios::binary | std::ios::ate);
+      proof_bytes = static_cast<long>(in.tellg());
+      result = check(options, proof, output);
+    }
+    if (!result.ok) {
+      failed = true;
+      fprintf(stderr, "%-22s failed, see %s\n", benchmark->name, directory);
+    } else {
+      fprintf(stderr, "%-22s %10ld %9.3f %9.1f %12.0f %14.0f\n", benchmark->name, result.rules,
+              result.seconds, result.peak_rss_kb / 1024.0, rate(result.rules, result.seconds),
+              rate(result.monomial_products, result.seconds));
+      unlink(output.c_str());
+      unlink(proof.c_str());
+    }
+    report(json, *benchmark, proof_bytes, result, benchmark == selected.back());
+  }
+  json << "  ]\n}\n";
+  if (!failed) rmdir(directory);
+
+  if (options.output.empty()) {
+    std::cout << json.str();
+  } else {
+    std::ofstream out(options.output);
+    out << json.str();
+    if (!out) {
+      std::cerr << "bench: cannot write " << options.output << "\n";
+      return 1;
+    }
+  }
+  return failed;
+}
@@ -0,0 +1,46 @@
+#!/bin/sh
+# Regression checks on generated proofs, run by 'make check' from the
+# top directory, with the checker given by $PACHECK if set. Prints one
+# line per check and fails if any fails.
+#
+# Part of Pacheck 3.0 : PAC proof checker.
+
+pacheck=${PACHECK:-./pacheck}
+generate=./bench/generate
+dir=$(mktemp -d) || exit 1
+trap 'rm -rf "$dir"' EXIT
+failed=0
+
+ok() { echo "ok   $1"; }
+fail() { echo "FAIL $1"; failed=1; }
+
+# writes the conclusion of the last '%' rule of proof $1 to $2
+target() { grep '%' "$1" | tail -n 1 | sed 's/.*,\(.*\);.*/\1/' > "$2"; }
+
+# resumes a check with a target from a checkpoint written by a run that
+# failed on an appended line, with options $2 for both runs
+resume() {
+  name=$1 options=$2 proof=$dir/$1.pac
+  target "$proof" "$dir/$name.tgt"
+  cp "$proof" "$dir/$name.bad.pac"
+  echo "999999 d;" >> "$dir/$name.bad.pac"
+  lines=$(grep -c . "$proof")
+  $pacheck $options --checkpoint-every $((lines - 1)) "$dir/$name.bad.pac" "$dir/$name.tgt" \
+    > /dev/null 2>&1
+  if [ -f "$dir/$name.bad.pac.checkpoint" ] \
+     && $pacheck $options --resume "$dir/$name.bad.pac.checkpoint" "$proof" "$dir/$name.tgt" \
+       2>&1 | grep -q "^Target polynomial derived"; then
+    ok "resume $name $options"
+  else
+    fail "resume $name $options"
+  fi
+}
+
+$generate --shape multiplier --bits 6 > "$dir/mult6.pac"
+$generate --shape multiplier --bits 6 --modulus 4099 > "$dir/mult6p.pac"
+resume mult6 ""
+resume mult6 "--fingerprints"  # modulus 4096, fingerprints are turned off
+resume mult6p "--fingerprints"
+resume mult6 "--threads 2"
+
+exit $failed
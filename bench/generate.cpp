@@ -0,0 +1,479 @@
+/*------------------------------------------------------------------------*/
+/*! \file generate.cpp
+    \brief generator of synthetic PAC proofs for benchmarking
+
+  Writes a correct proof to standard output, whose conclusions are
+  computed with the polynomial arithmetic of the checker. Two shapes of
+  proofs are supported:
+
+    multiplier  the gate polynomials of an N x N bit multiplier, where the
+                partial products are summed by full and half adders, and
+                the derivation of the word-level specification from them
+                by backward substitution, as produced for multiplier
+                verification, each step taking the remainder as antecedent
+
+    random      random axioms and linear combinations of them with random
+                multipliers, of controllable size and degree
+
+  With '--depth K' the rules are repeated in every node of a complete case
+  split on K Boolean variables, declared by 'r' and entered by 'b' rules,
+  where every leaf is closed by deriving 1.
+
+  Part of Pacheck 3.0 : PAC proof checker.
+*/
+/*------------------------------------------------------------------------*/
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+#include "../src/polynomial.hpp"
+/*------------------------------------------------------------------------*/
+
+struct Options {
+  std::string shape = "random";
+  std::string modulus;  // default depends on the shape
+  unsigned bits = 8;
+  unsigned variables = 16;
+  unsigned terms = 20;
+  unsigned degree = 4;
+  unsigned rules = 100;
+  unsigned antecedents = 3;
+  unsigned depth = 0;
+  unsigned seed = 1;
+};
+
+static void usage() {
+  std::cerr << "usage: generate [ <option> ... ]\n"
+            << "  --shape multiplier|random  kind of proof (default random)\n"
+            << "  --modulus M                modulus (default 2^(2N) resp. 2^31 - 1)\n"
+            << "  --bits N                   width of the multiplier (default 8)\n"
+            << "  --variables V              variables of random axioms (default 16)\n"
+            << "  --terms T                  terms of random axioms (default 20)\n"
+            << "  --degree D                 degree of random monomials (default 4)\n"
+            << "  --rules R                  random rules per node (default 100)\n"
+            << "  --antecedents K            antecedents of random rules (default 3)\n"
+            << "  --depth K                  depth of the case split (default 0)\n"
+            << "  --seed S                   random seed (default 1)\n";
+}
+
+static bool parseOptions(int argc, char* argv[], Options& options) {
+  for (int i = 1; i < argc; ++i) {
+    if (i + 1 == argc) return false;
+    const char* arg = argv[i];
+    const char* value = argv[++i];
+    if (!strcmp(arg, "--shape")) {
+      options.shape = value;
+      if (options.shape != "multiplier" && options.shape != "random") return false;
+      continue;
+    }
+    if (!strcmp(arg, "--modulus")) {
+      options.modulus = value;
+      continue;
+    }
+    char* end;
+    const unsigned long n = strtoul(value, &end, 10);
+    if (*end || end == value || n > 1u << 20) return false;
+    if (!strcmp(arg, "--bits")) options.bits = n;
+    else if (!strcmp(arg, "--variables")) options.variables = n;
+    else if (!strcmp(arg, "--terms")) options.terms = n;
+    else if (!strcmp(arg, "--degree")) options.degree = n;
+    else if (!strcmp(arg, "--rules")) options.rules = n;
+    else if (!strcmp(arg, "--antecedents")) options.antecedents = n;
+    else if (!strcmp(arg, "--depth")) options.depth = n;
+    else if (!strcmp(arg, "--seed")) options.seed = n;
+    else return false;
+  }
+  return options.bits > 0 && options.variables > 0 && options.antecedents > 0;
+}
+
+/// decimal digits of 2^k
+static std::string powerOfTwo(unsigned k) {
+  std::string digits = "1";  // least significant first
+  for (unsigned i = 0; i < k; ++i) {
+    int carry = 0;
+    for (char& d : digits) {
+      const int x = 2 * (d - '0') + carry;
+      d = static_cast<char>('0' + x % 10);
+      carry = x / 10;
+    }
+    if (carry) digits.push_back('1');
+  }
+  return std::string(digits.rbegin(), digits.rend());
+}
+
+/// interns the variable 'prefix' followed by 'index'
+static Var numberedVariable(char prefix, size_t index) {
+  std::string name(1, prefix);
+  name += std::to_string(index);
+  return internVariable(name);
+}
+/*------------------------------------------------------------------------*/
+// Output
+
+static int next_id = 1;
+
+static void printRule(int id, const char* kind, const Polynomial& poly) {
+  std::cout << id << ' ' << kind << ' ';
+  printPolynomial(poly);
+  std::cout << ";\n";
+}
+
+/// writes an axiom and returns its ID
+static int axiom(const Polynomial& poly) {
+  const int id = next_id++;
+  printRule(id, "a", poly);
+  return id;
+}
+
+/// writes the '%' rule deriving the sum of products and returns its ID
+static int derive(const std::vector<std::pair<int, Polynomial>>& products,
+                  const Polynomial& conclusion) {
+  const int id = next_id++;
+  std::cout << id << " %";
+  const char* separator = " ";
+  for (const auto& [antecedent, multiplier] : products) {
+    std::cout << separator << antecedent << " * (";
+    printPolynomial(multiplier);
+    std::cout << ")";
+    separator = " + ";
+  }
+  std::cout << ", ";
+  printPolynomial(conclusion);
+  std::cout << ";\n";
+  return id;
+}
+
+static Polynomial constant(int64_t value) { return makePolynomial(coeffFromInt(value)); }
+
+static Polynomial variable(Var var) { return makePolynomial(coeffFromInt(1), Monomial(var, 1)); }
+
+static Polynomial sum(std::vector<Polynomial> parts) {
+  PolynomialAccumulator accumulator;
+  for (Polynomial& p : parts) accumulator.add(std::move(p));
+  return accumulator.sum();
+}
+
+static Polynomial negate(const Polynomial& p) {
+  return multiplyPolynomialByConstant(p, coeffFromInt(-1));
+}
+/*------------------------------------------------------------------------*/
+// Multipliers
+
+/// a gate 'output' = 'function' of earlier gates and inputs
+struct Gate {
+  Var output;
+  Polynomial function;
+  int id = 0;  // of the axiom -output + function
+};
+
+struct Circuit {
+  std::vector<Gate> gates;  // in topological order
+  Polynomial specification;
+};
+
+static Var newGate(Circuit& circuit, Polynomial function) {
+  const Var output = numberedVariable('g', circuit.gates.size());
+  circuit.gates.push_back({output, std::move(function)});
+  return output;
+}
+
+/// x + y + ... - 2xy - ... + 4xyz, i.e. the sum bit of 2 or 3 bits
+static Polynomial sumBit(const std::vector<Var>& in) {
+  std::vector<Polynomial> parts;
+  for (Var v : in) parts.push_back(variable(v));
+  for (size_t i = 0; i < in.size(); ++i) {
+    for (size_t j = i + 1; j < in.size(); ++j) {
+      parts.push_back(multiplyPolynomialByConstant(
+          multiplyPolynomials(variable(in[i]), variable(in[j])), coeffFromInt(-2)));
+    }
+  }
+  if (in.size() == 3) {
+    parts.push_back(multiplyPolynomialByConstant(
+        multiplyPolynomials(multiplyPolynomials(variable(in[0]), variable(in[1])), variable(in[2])),
+        coeffFromInt(4)));
+  }
+  return sum(std::move(parts));
+}
+
+/// the majority xy + xz + yz - 2xyz of 3 bits, the conjunction of 2 bits
+static Polynomial carryBit(const std::vector<Var>& in) {
+  if (in.size() == 2) return multiplyPolynomials(variable(in[0]), variable(in[1]));
+  std::vector<Polynomial> parts;
+  for (size_t i = 0; i < 3; ++i) {
+    for (size_t j = i + 1; j < 3; ++j) {
+      parts.push_back(multiplyPolynomials(variable(in[i]), variable(in[j])));
+    }
+  }
+  parts.push_back(multiplyPolynomialByConstant(
+      multiplyPolynomials(multiplyPolynomials(variable(in[0]), variable(in[1])), variable(in[2])),
+      coeffFromInt(-2)));
+  return sum(std::move(parts));
+}
+
+/// partial products summed column by column with full and half adders
+static Circuit buildMultiplier(unsigned n) {
+  Circuit circuit;
+  std::vector<Var> a, b;
+  for (unsigned i = 0; i < n; ++i) a.push_back(numberedVariable('a', i));
+  for (unsigned i = 0; i < n; ++i) b.push_back(numberedVariable('b', i));
+
+  std::vector<std::vector<Var>> columns(2 * n);
+  for (unsigned i = 0; i < n; ++i) {
+    for (unsigned j = 0; j < n; ++j) {
+      columns[i + j].push_back(
+          newGate(circuit, multiplyPolynomials(variable(a[i]), variable(b[j]))));
+    }
+  }
+
+  std::vector<Polynomial> outputs;
+  Coeff weight = coeffFromInt(1);
+  for (size_t k = 0; k < columns.size(); ++k) {
+    // the bits of a column are consumed in the order they appear
+    for (size_t next = 0; columns[k].size() - next > 1;) {
+      const size_t width = std::min<size_t>(3, columns[k].size() - next);
+      std::vector<Var> in(columns[k].begin() + next, columns[k].begin() + next + width);
+      next += width;
+      columns[k].push_back(newGate(circuit, sumBit(in)));
+      if (k + 1 == columns.size()) columns.emplace_back();
+      columns[k + 1].push_back(newGate(circuit, carryBit(in)));
+    }
+    if (!columns[k].empty()) {
+      outputs.push_back(multiplyPolynomialByConstant(variable(columns[k].back()), weight));
+    }
+    weight = mulCoeff(weight, coeffFromInt(2));
+  }
+
+  // sum 2^k o_k - (sum 2^i a_i) (sum 2^j b_j)
+  std::vector<Polynomial> words[2];
+  weight = coeffFromInt(1);
+  for (unsigned i = 0; i < n; ++i) {
+    words[0].push_back(multiplyPolynomialByConstant(variable(a[i]), weight));
+    words[1].push_back(multiplyPolynomialByConstant(variable(b[i]), weight));
+    weight = mulCoeff(weight, coeffFromInt(2));
+  }
+  Polynomial product = multiplyPolynomials(sum(std::move(words[0])), sum(std::move(words[1])));
+  outputs.push_back(negate(product));
+  circuit.specification = sum(std::move(outputs));
+  return circuit;
+}
+
+/// splits 'poly' = v * q + r into the multiplier q with
+/// 'poly' + q * ('function' - v) = r + q * 'function', where powers v^e
+/// contribute v^(e-1) + v^(e-2) f + ... + f^(e-1) to q
+static Polynomial quotient(const Polynomial& poly, Var v, const Polynomial& function) {
+  std::vector<Polynomial> parts;
+  for (const auto& [mono, coeff] : poly) {
+    const uint32_t exp = mono.exponent(v);
+    if (!exp) continue;
+    std::vector<VarPower> rest;
+    for (const VarPower& factor : mono) {
+      if (factor.var != v) rest.push_back(factor);
+    }
+    TermVector term;
+    term.push_back({Monomial(rest.data(), rest.size()), coeff});
+    const Polynomial cofactor{std::move(term)};
+    Polynomial power = constant(1);  // f^i
+    for (uint32_t i = 0; i < exp; ++i) {
+      const uint32_t e = exp - 1 - i;
+      Polynomial vpower = e ? makePolynomial(coeffFromInt(1), Monomial(v, e)) : constant(1);
+      parts.push_back(multiplyPolynomials(cofactor, multiplyPolynomials(vpower, power)));
+      power = multiplyPolynomials(power, function);
+    }
+  }
+  return sum(std::move(parts));
+}
+
+/// multipliers of the backward substitution, from the last gate on
+struct Substitution {
+  std::vector<std::pair<size_t, Polynomial>> steps;  // gate, multiplier
+};
+
+static Substitution substituteBackwards(const Circuit& circuit) {
+  Substitution result;
+  Polynomial remainder = circuit.specification;
+  for (size_t g = circuit.gates.size(); g-- > 0;) {
+    const Gate& gate = circuit.gates[g];
+    Polynomial q = quotient(remainder, gate.output, gate.function);
+    if (q.empty()) continue;
+    Polynomial axiom = addPolynomials(gate.function, negate(variable(gate.output)));
+    remainder = addPolynomials(remainder, multiplyPolynomials(q, axiom));
+    result.steps.emplace_back(g, std::move(q));
+  }
+  if (!remainder.empty()) {
+    std::cerr << "generate: warning, the specification has a remainder of " << remainder.size()
+              << " terms\n";
+  }
+  return result;
+}
+
+/// derives the specification, deriving the remainders of the backward
+/// substitution in reverse, where each one is used once and deleted
+static void deriveSpecification(const Circuit& circuit, const Substitution& substitution,
+                                std::vector<int>& live) {
+  int previous = 0;
+  Polynomial derived;
+  for (size_t k = substitution.steps.size(); k-- > 0;) {
+    const auto& [g, q] = substitution.steps[k];
+    const Gate& gate = circuit.gates[g];
+    Polynomial multiplier = negate(q);
+    Polynomial axiom = addPolynomials(gate.function, negate(variable(gate.output)));
+    derived = addPolynomials(derived, multiplyPolynomials(multiplier, axiom));
+    std::vector<std::pair<int, Polynomial>> products;
+    if (previous) products.emplace_back(previous, constant(1));
+    products.emplace_back(gate.id, std::move(multiplier));
+    const int id = derive(products, derived);
+    if (previous) std::cout << previous << " d;\n";
+    previous = id;
+  }
+  if (previous) live.push_back(previous);
+}
+/*------------------------------------------------------------------------*/
+// Random proofs
+
+struct RandomProof {
+  std::vector<std::pair<int, Polynomial>> axioms;
+  std::vector<Var> variables;
+};
+
+static Polynomial randomPolynomial(std::mt19937_64& rng, const std::vector<Var>& vars,
+                                   unsigned terms, unsigned degree) {
+  TermVector result;
+  std::vector<VarPower> factors;
+  for (unsigned i = 0; i < terms; ++i) {
+    const unsigned size = rng() % (degree + 1);
+    factors.clear();
+    for (unsigned k = 0; k < size; ++k) factors.push_back({vars[rng() % vars.size()], 1});
+    std::sort(factors.begin(), factors.end(),
+              [](const VarPower& x, const VarPower& y) { return x.var < y.var; });
+    // repeated variables become powers
+    std::vector<VarPower> merged;
+    for (const VarPower& f : factors) {
+      if (!merged.empty() && merged.back().var == f.var) merged.back().exp++;
+      else merged.push_back(f);
+    }
+    Coeff c = randomCoeff(rng);
+    if (c == 0) c = coeffFromInt(1);
+    result.push_back({Monomial(merged.data(), merged.size()), c});
+  }
+  // equal monomials are merged by the accumulator
+  PolynomialAccumulator accumulator;
+  for (Term& t : result) {
+    TermVector single;
+    single.push_back(std::move(t));
+    accumulator.add(Polynomial(std::move(single)));
+  }
+  return accumulator.sum();
+}
+
+static void deriveRandom(std::mt19937_64& rng, const Options& options, const RandomProof& proof,
+                         std::vector<int>& live) {
+  const unsigned multiplier_terms = std::max(1u, options.terms / 4);
+  for (unsigned r = 0; r < options.rules; ++r) {
+    std::vector<std::pair<int, Polynomial>> products;
+    PolynomialAccumulator conclusion;
+    for (unsigned k = 0; k < options.antecedents; ++k) {
+      const auto& [id, poly] = proof.axioms[rng() % proof.axioms.size()];
+      Polynomial multiplier = randomPolynomial(rng, proof.variables, multiplier_terms,
+                                               std::min(2u, options.degree));
+      conclusion.add(multiplyPolynomials(poly, multiplier));
+      products.emplace_back(id, std::move(multiplier));
+    }
+    live.push_back(derive(products, conclusion.sum()));
+  }
+}
+/*------------------------------------------------------------------------*/
+// Case splits
+
+struct CaseSplit {
+  std::vector<int> roots;  // IDs of y^2 - y per level
+  std::vector<Var> vars;
+  int closing = 0;  // ID of 1 + sum (y^2 - y) * c * x
+  Polynomial closing_poly;
+};
+
+static CaseSplit declareCaseSplit(std::mt19937_64& rng, unsigned depth, Var x) {
+  CaseSplit split;
+  std::vector<Polynomial> closing{constant(1)};
+  for (unsigned i = 0; i < depth; ++i) {
+    const Var y = numberedVariable('y', i);
+    Polynomial boolean =
+        addPolynomials(makePolynomial(coeffFromInt(1), Monomial(y, 2)), negate(variable(y)));
+    split.vars.push_back(y);
+    split.roots.push_back(axiom(boolean));
+    Coeff c = randomCoeff(rng);
+    if (c == 0) c = coeffFromInt(1);
+    closing.push_back(multiplyPolynomials(boolean, makePolynomial(c, Monomial(x, 1))));
+  }
+  if (depth) {
+    split.closing_poly = sum(std::move(closing));
+    split.closing = axiom(split.closing_poly);
+  }
+  return split;
+}
+
+template <class F>
+static void caseSplit(const CaseSplit& split, unsigned level, const F& body) {
+  std::vector<int> live;
+  body(live);
+  if (level == split.vars.size()) {
+    if (level) live.push_back(derive({{split.closing, constant(1)}}, split.closing_poly));
+  } else {
+    const std::string& name = variableName(split.vars[level]);
+    std::cout << split.roots[level] << " r " << name << " 0 1;\n";
+    for (int value = 0; value < 2; ++value) {
+      std::cout << "b " << name << ' ' << value << ";\n";
+      caseSplit(split, level + 1, body);
+    }
+  }
+  for (int id : live) std::cout << id << " d;\n";
+}
+/*------------------------------------------------------------------------*/
+
+int main(int argc, char* argv[]) {
+  Options options;
+  if (!parseOptions(argc, argv, options)) {
+    usage();
+    return 1;
+  }
+  const bool multiplier = options.shape == "multiplier";
+  if (options.modulus.empty()) {
+    if (!multiplier) options.modulus = "2147483647";
+    else options.modulus = powerOfTwo(std::min(2 * options.bits, 64u));
+  }
+  if (!setModulus(options.modulus)) {
+    std::cerr << "generate: modulus " << options.modulus << " is not supported by this build\n";
+    return 1;
+  }
+  std::ios::sync_with_stdio(false);
+  std::mt19937_64 rng(options.seed);
+  std::cout << "m " << options.modulus << ";\n";
+
+  if (multiplier) {
+    Circuit circuit = buildMultiplier(options.bits);
+    for (Gate& gate : circuit.gates) {
+      gate.id = axiom(addPolynomials(gate.function, negate(variable(gate.output))));
+    }
+    const Substitution substitution = substituteBackwards(circuit);
+    const CaseSplit split = declareCaseSplit(rng, options.depth, internVariable("a0"));
+    caseSplit(split, 0, [&](std::vector<int>& live) {
+      deriveSpecification(circuit, substitution, live);
+    });
+  } else {
+    RandomProof proof;
+    for (unsigned i = 0; i < options.variables; ++i) {
+      proof.variables.push_back(numberedVariable('x', i));
+    }
+    // every variable occurs in an axiom, so multipliers may use all of them
+    for (Var v : proof.variables) {
+      Polynomial p = addPolynomials(
+          randomPolynomial(rng, proof.variables, options.terms, options.degree), variable(v));
+      proof.axioms.emplace_back(axiom(p), std::move(p));
+    }
+    const CaseSplit split = declareCaseSplit(rng, options.depth, proof.variables[0]);
+    caseSplit(split, 0, [&](std::vector<int>& live) { deriveRandom(rng, options, proof, live); });
+  }
+  return 0;
+}
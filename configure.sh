@@ -12,6 +12,7 @@ where <option> is one of the following
   -h      print this command line option summary
   -g      compile with debugging support
   -c      compile with assertion checking(default with '-g')
+  --gmp   use arbitrary precision coefficients (moduli beyond 2^64 or 'm 0')
 
 and for debugging and testing you can also use
 
@@ -21,6 +22,7 @@ EOF
 }
 debug=no
 check=undefined
+gmp=no
 test
 while [ $# -gt 0 ]
 do
@@ -28,6 +30,7 @@ do
     -h|--help) usage; exit 0;;
     -c) check=yes;;
     -g) debug=yes;;
+    --gmp) gmp=yes;;
     -*) die "invalid option '$1'(try '-h')";;
   esac
   shift
@@ -39,7 +42,7 @@ elif [ $check = undefined ]
 then
   check=no
 fi
-CFLAGS="-Wall -Wextra -std=c++20"
+CFLAGS="-Wall -Wextra -std=c++20 -pthread"
 if [ $debug = yes ]
 then
   CFLAGS="$CFLAGS -g3"
@@ -47,6 +50,12 @@ else
   CFLAGS="$CFLAGS -O3"
 fi
 [ $check = no ] && CFLAGS="$CFLAGS -DNDEBUG"
+LIBS="-lgmp"
+if [ $gmp = yes ]
+then
+  CFLAGS="$CFLAGS -DPACHECK_GMP"
+  LIBS="-lgmpxx $LIBS"
+fi
 [ "$CC" = "" ] && CC=g++
 
 
@@ -91,6 +100,26 @@ EOF
     [ $? = 42 ] && CFLAGS="$CFLAGS -DHAVEUNLOCKEDIO"
   fi
   rm -f $tmp*
+cat >$tmp.c <<EOF
+#include <zlib.h>
+int main() { return zlibVersion() ? 42 : 1; }
+EOF
+  if $CC $CFLAGS $tmp.c -o $tmp.exe -lz 1>/dev/null 2>/dev/null
+  then
+    $tmp.exe 1>/dev/null 2>/dev/null
+    [ $? = 42 ] && CFLAGS="$CFLAGS -DHAVEZLIB" && LIBS="$LIBS -lz"
+  fi
+  rm -f $tmp*
+cat >$tmp.c <<EOF
+#include <lzma.h>
+int main() { return lzma_version_number() ? 42 : 1; }
+EOF
+  if $CC $CFLAGS $tmp.c -o $tmp.exe -llzma 1>/dev/null 2>/dev/null
+  then
+    $tmp.exe 1>/dev/null 2>/dev/null
+    [ $? = 42 ] && CFLAGS="$CFLAGS -DHAVELZMA" && LIBS="$LIBS -llzma"
+  fi
+  rm -f $tmp*
 fi
 
 
@@ -110,4 +139,5 @@ fi
 sed \
   -e "s,@CC@,$CC," \
   -e "s,@CFLAGS@,$CFLAGS," \
+  -e "s,@LIBS@,$LIBS," \
 makefile.in > makefile
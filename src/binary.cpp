@@ -0,0 +1,345 @@
+/*------------------------------------------------------------------------*/
+/*! \file binary.cpp
+    \brief compact binary encoding of PAC proofs
+
+  Part of Pacheck 3.0 : PAC proof checker.
+*/
+/*------------------------------------------------------------------------*/
+#include "binary.h"
+#include "profile.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <climits>
+#include <cstring>
+/*------------------------------------------------------------------------*/
+const char* const binary_proof_magic = "BPAC";
+static const uint8_t binary_proof_version = 1;
+static const size_t write_buffer_size = 1 << 20;
+/*------------------------------------------------------------------------*/
+// Decoding
+
+bool BinaryProofReader::refill() {
+  const char* data;
+  size_t size;
+  if (!reader_.nextBlock(data, size)) {
+    truncated_ = true;
+    return false;
+  }
+  pos_ = reinterpret_cast<const uint8_t*>(data);
+  end_ = pos_ + size;
+  return true;
+}
+
+bool BinaryProofReader::fail(const std::string& message) {
+  if (error_.empty()) {
+    error_ = "malformed binary proof, " + message;
+    if (rules_) error_ += " in rule " + std::to_string(rules_);
+  }
+  return false;
+}
+
+uint64_t BinaryProofReader::varint() {
+  uint64_t value = 0;
+  for (unsigned shift = 0; shift < 64; shift += 7) {
+    const uint8_t b = byte();
+    value |= uint64_t(b & 127) << shift;
+    if (!(b & 128)) return value;
+  }
+  fail("overlong number");
+  return 0;
+}
+
+int64_t BinaryProofReader::signedVarint() {
+  const uint64_t z = varint();
+  return static_cast<int64_t>(z >> 1) ^ -static_cast<int64_t>(z & 1);
+}
+
+int BinaryProofReader::id() {
+  const uint64_t value = varint();
+  if (value > INT_MAX) fail("ID out of range");
+  return static_cast<int>(value);
+}
+
+size_t BinaryProofReader::variable() {
+  const uint64_t index = varint();
+  if (index >= names_.size()) {
+    fail("undefined variable");
+    return 0;
+  }
+  return index;
+}
+
+void BinaryProofReader::string(std::string& s) {
+  const uint64_t size = varint();
+  s.clear();
+  while (s.size() < size && !truncated_) {
+    if (pos_ == end_ && !refill()) break;
+    const size_t n = std::min<uint64_t>(size - s.size(), end_ - pos_);
+    s.append(reinterpret_cast<const char*>(pos_), n);
+    pos_ += n;
+  }
+}
+
+Coeff BinaryProofReader::coefficient(bool negative) {
+  // magnitudes of up to 63 bits are reduced as machine integers
+  uint64_t value = 0;
+  for (unsigned shift = 0; shift < 63; shift += 7) {
+    const uint8_t b = byte();
+    value |= uint64_t(b & 127) << shift;
+    if (!(b & 128)) {
+      const int64_t v = static_cast<int64_t>(value);
+      return coeffFromInt(negative ? -v : v);
+    }
+  }
+  digits_.clear();
+  for (unsigned shift = 0; shift < 63; shift += 7) digits_.push_back((value >> shift) & 127);
+  uint8_t b;
+  do {
+    b = byte();
+    digits_.push_back(b & 127);
+  } while ((b & 128) && !truncated_);
+  const Coeff c = coeffFromBase128(digits_.data(), digits_.size());
+  return negative ? negCoeff(c) : c;
+}
+
+static bool lessVar(const VarPower& a, const VarPower& b) { return a.var < b.var; }
+
+Polynomial BinaryProofReader::polynomial() {
+  const uint64_t size = varint();
+  if (skip_polynomials_) {
+    for (uint64_t i = 0; i < size && !truncated_; ++i) {
+      const uint64_t head = varint();
+      while ((byte() & 128) && !truncated_) {}
+      for (uint64_t k = 0; k < 2 * (head >> 1) && !truncated_; ++k) varint();
+    }
+    return Polynomial();
+  }
+  TermVector terms;
+  terms.reserve(std::min<uint64_t>(size, 1 << 16));  // bounded for malformed input
+  for (uint64_t i = 0; i < size && !truncated_ && error_.empty(); ++i) {
+    const uint64_t head = varint();
+    const Coeff coeff = coefficient(head & 1);
+    factors_.clear();
+    bool sorted = true;
+    uint64_t next = 0;  // smallest index of the next factor
+    for (uint64_t k = 0; k < head >> 1 && !truncated_; ++k) {
+      const uint64_t delta = varint();
+      if (delta >= names_.size() - next) {
+        fail("undefined variable");
+        break;
+      }
+      const size_t index = next + delta;
+      next = index + 1;
+      const uint64_t exp = varint();
+      if (exp == 0 || exp > UINT32_MAX) {
+        fail("invalid exponent");
+        break;
+      }
+      // the table may order variables differently if it was filled before
+      if (!factors_.empty() && vars_[index] < factors_.back().var) sorted = false;
+      factors_.push_back({vars_[index], static_cast<uint32_t>(exp)});
+    }
+    if (!sorted) std::sort(factors_.begin(), factors_.end(), lessVar);
+    for (size_t k = 1; k < factors_.size(); ++k) {
+      if (factors_[k - 1].var == factors_[k].var) fail("repeated variable");
+    }
+    if (!error_.empty()) break;
+    terms.push_back({Monomial(factors_.data(), factors_.size()), coeff});
+  }
+  return Polynomial(std::move(terms));
+}
+
+bool BinaryProofReader::next(Rule& rule) {
+  OperationScope scope(Operation::Parse);
+  if (!started_) {
+    started_ = true;
+    for (const char* m = binary_proof_magic; *m; ++m) {
+      if (byte() != static_cast<uint8_t>(*m)) return fail("missing magic bytes");
+    }
+    if (byte() != binary_proof_version) return fail("unsupported version");
+  }
+
+  while (true) {
+    if (pos_ == end_ && !refill()) return false;  // at a record boundary
+    const uint8_t tag = *pos_++;
+    if (tag != 'v') {
+      rules_++;
+      switch (tag) {
+        case 'm':
+          rule.kind = Rule::Mod;
+          string(modulus_);
+          rule.text = modulus_;
+          break;
+        case 'a':
+          rule.kind = Rule::Axiom;
+          rule.id = id();
+          rule.poly = polynomial();
+          break;
+        case 'd':
+          rule.kind = Rule::Delete;
+          rule.id = id();
+          break;
+        case '%': {
+          rule.kind = Rule::LinComb;
+          rule.id = id();
+          const uint64_t n = varint();
+          for (uint64_t i = 0; i < n && !truncated_ && error_.empty(); ++i) {
+            const int antecedent = id();
+            rule.products.emplace_back(antecedent, polynomial());
+          }
+          rule.poly = polynomial();
+          break;
+        }
+        case 'r': {
+          rule.kind = Rule::Root;
+          rule.id = id();
+          const size_t index = variable();
+          if (!error_.empty()) return false;
+          rule.text = names_[index];
+          rule.var = vars_[index];
+          const uint64_t n = varint();
+          for (uint64_t i = 0; i < n && !truncated_; ++i) {
+            rule.values.push_back(static_cast<int>(signedVarint()));
+          }
+          if (n == 0) fail("missing roots");
+          break;
+        }
+        case 'b': {
+          rule.kind = Rule::Branch;
+          const size_t index = variable();
+          if (!error_.empty()) return false;
+          rule.text = names_[index];
+          rule.var = vars_[index];
+          rule.values.push_back(static_cast<int>(signedVarint()));
+          break;
+        }
+        default:
+          return fail("unknown record");
+      }
+      if (truncated_) return fail("truncated record");
+      return error_.empty();
+    }
+
+    // the next dictionary entry
+    names_.emplace_back();
+    string(names_.back());
+    if (truncated_) return fail("truncated record");
+    if (names_.back().empty()) return fail("empty variable name");
+    vars_.push_back(internVariable(names_.back()));
+  }
+}
+/*------------------------------------------------------------------------*/
+// Encoding
+
+BinaryProofWriter::~BinaryProofWriter() {
+  if (file_) fclose(file_);
+}
+
+bool BinaryProofWriter::open(const std::string& path) {
+  file_ = fopen(path.c_str(), "wb");
+  if (!file_) {
+    error_ = strerror(errno);
+    return false;
+  }
+  buffer_.append(binary_proof_magic);
+  buffer_.push_back(binary_proof_version);
+  return true;
+}
+
+void BinaryProofWriter::varint(uint64_t value) {
+  while (value >= 128) {
+    buffer_.push_back(static_cast<char>(value | 128));
+    value >>= 7;
+  }
+  buffer_.push_back(static_cast<char>(value));
+}
+
+void BinaryProofWriter::signedVarint(int64_t value) {
+  varint((static_cast<uint64_t>(value) << 1) ^ static_cast<uint64_t>(value >> 63));
+}
+
+void BinaryProofWriter::string(std::string_view s) {
+  varint(s.size());
+  buffer_.append(s);
+}
+
+void BinaryProofWriter::polynomial(const Polynomial& poly) {
+  varint(poly.size());
+  for (const auto& [mono, coeff] : poly) {
+    const bool negative = isNegativeCoeff(coeff);
+    varint(uint64_t(mono.size()) << 1 | negative);
+    digits_.clear();
+    coeffToBase128(negative ? negCoeff(coeff) : coeff, digits_);
+    for (size_t i = 0; i + 1 < digits_.size(); ++i) buffer_.push_back(digits_[i] | 128);
+    buffer_.push_back(digits_.back());
+    int64_t previous = -1;
+    for (const auto& [var, exp] : mono) {
+      varint(var - previous - 1);
+      varint(exp);
+      previous = var;
+    }
+  }
+}
+
+void BinaryProofWriter::write(const Rule& rule) {
+  // every variable enters the dictionary before its first use
+  for (; variables_ < numVariables(); ++variables_) {
+    buffer_.push_back('v');
+    string(variableName(variables_));
+  }
+
+  switch (rule.kind) {
+    case Rule::Mod:
+      buffer_.push_back('m');
+      string(rule.text);
+      break;
+    case Rule::Axiom:
+      buffer_.push_back('a');
+      varint(rule.id);
+      polynomial(rule.poly);
+      break;
+    case Rule::Delete:
+      buffer_.push_back('d');
+      varint(rule.id);
+      break;
+    case Rule::LinComb:
+      buffer_.push_back('%');
+      varint(rule.id);
+      varint(rule.products.size());
+      for (const auto& [antecedent, multiplier] : rule.products) {
+        varint(antecedent);
+        polynomial(multiplier);
+      }
+      polynomial(rule.poly);
+      break;
+    case Rule::Root:
+      buffer_.push_back('r');
+      varint(rule.id);
+      varint(rule.var);
+      varint(rule.values.size());
+      for (int root : rule.values) signedVarint(root);
+      break;
+    case Rule::Branch:
+      buffer_.push_back('b');
+      varint(rule.var);
+      signedVarint(rule.values[0]);
+      break;
+  }
+  if (buffer_.size() >= write_buffer_size) flush();
+}
+
+void BinaryProofWriter::flush() {
+  if (error_.empty() && fwrite(buffer_.data(), 1, buffer_.size(), file_) != buffer_.size()) {
+    error_ = strerror(errno);
+  }
+  written_ += buffer_.size();
+  buffer_.clear();
+}
+
+bool BinaryProofWriter::close() {
+  flush();
+  if (fclose(file_) && error_.empty()) error_ = strerror(errno);
+  file_ = nullptr;
+  return error_.empty();
+}
@@ -0,0 +1,135 @@
+/*------------------------------------------------------------------------*/
+/*! \file binary.h
+    \brief compact binary encoding of PAC proofs
+
+  A binary proof starts with the magic bytes "BPAC" and a version byte,
+  followed by one record per rule. A record is a tag byte followed by its
+  fields, where all numbers are LEB128 varints and signed numbers are
+  zigzag encoded:
+
+    'v' <length> <name>                  next variable of the dictionary
+    'm' <length> <decimal digits>        modulus
+    'a' <id> <poly>                      axiom
+    'd' <id>                             deletion
+    '%' <id> <n> (<id> <poly>)^n <poly>  linear combination
+    'r' <id> <var> <n> <root>^n          roots (signed)
+    'b' <var> <value>                    branch (signed)
+
+  Variables are referenced by their index in the dictionary, which lists
+  every variable before its first use. A polynomial is its number of
+  terms followed by the terms, each given by
+
+    <size * 2 + negative> <magnitude> (<var delta> <exp>)^size
+
+  where the magnitude of the coefficient is an LEB128 number of arbitrary
+  length and the factors are sorted by variable, each delta being the
+  distance to the previous variable (initially -1) minus one. Record
+  numbers take the place of line numbers in error messages.
+
+  Part of Pacheck 3.0 : PAC proof checker.
+*/
+/*------------------------------------------------------------------------*/
+#ifndef PACHECK2_SRC_BINARY_H_
+#define PACHECK2_SRC_BINARY_H_
+/*------------------------------------------------------------------------*/
+#include <cstdint>
+#include <cstdio>
+#include <string>
+#include <vector>
+#include "parser.h"
+#include "reader.h"
+/*------------------------------------------------------------------------*/
+
+/// magic bytes at the start of binary proofs
+extern const char* const binary_proof_magic;
+
+/// decodes the rules of a binary proof from 'reader'
+class BinaryProofReader {
+ public:
+  explicit BinaryProofReader(ProofReader& reader) : reader_(reader) {}
+  BinaryProofReader(const BinaryProofReader&) = delete;
+  BinaryProofReader& operator=(const BinaryProofReader&) = delete;
+
+  /// decodes the next rule, allocating within the current scope, returns
+  /// false at the end of the proof and if it is malformed
+  bool next(Rule& rule);
+
+  /// leaves the polynomials of further rules empty if 'skip', e.g. for a
+  /// pre-pass over the IDs of a proof, which then does not need the
+  /// modulus, or for rules before a checkpoint
+  void skipPolynomials(bool skip = true) { skip_polynomials_ = skip; }
+
+  /// non-empty if the proof is malformed
+  const std::string& error() const { return error_; }
+
+ private:
+  uint8_t byte() {
+    if (pos_ == end_ && !refill()) return 0;
+    return *pos_++;
+  }
+  bool refill();
+  uint64_t varint();
+  int64_t signedVarint();
+  int id();
+  size_t variable();
+  void string(std::string& s);
+  Polynomial polynomial();
+  Coeff coefficient(bool negative);
+  bool fail(const std::string& message);
+
+  ProofReader& reader_;
+  const uint8_t* pos_ = nullptr;
+  const uint8_t* end_ = nullptr;
+  bool started_ = false;
+  bool truncated_ = false;
+  bool skip_polynomials_ = false;
+  size_t rules_ = 0;  // decoded so far
+  std::string error_;
+
+  std::vector<std::string> names_;  // the dictionary
+  std::vector<Var> vars_;           // interned dictionary entries
+  std::string modulus_;
+  std::vector<uint8_t> digits_;
+  std::vector<VarPower> factors_;
+};
+
+/// encodes rules in the binary format
+class BinaryProofWriter {
+ public:
+  BinaryProofWriter() {}
+  ~BinaryProofWriter();
+  BinaryProofWriter(const BinaryProofWriter&) = delete;
+  BinaryProofWriter& operator=(const BinaryProofWriter&) = delete;
+
+  /// creates 'path', returns false on failure
+  bool open(const std::string& path);
+
+  /// encodes a parsed rule
+  void write(const Rule& rule);
+
+  /// flushes and closes the file, returns false on failure
+  bool close();
+
+  size_t bytesWritten() const { return written_ + buffer_.size(); }
+
+  /// non-empty if opening or writing failed
+  const std::string& error() const { return error_; }
+
+ private:
+  void varint(uint64_t value);
+  void signedVarint(int64_t value);
+  void string(std::string_view s);
+  void polynomial(const Polynomial& poly);
+  void flush();
+
+  FILE* file_ = nullptr;
+  std::string buffer_;
+  size_t written_ = 0;
+  std::string error_;
+
+  size_t variables_ = 0;  // in the dictionary, indexed like the table
+  std::vector<uint8_t> digits_;
+};
+
+/*------------------------------------------------------------------------*/
+#endif  // PACHECK2_SRC_BINARY_H_
@@ -0,0 +1,1120 @@
+/*------------------------------------------------------------------------*/
+/*! \file checker.cpp
+    \brief checking a proof with a state of its own
+
+  With more than one thread the products and sums of '%' rules are
+  checked on a thread pool while the proof is parsed ahead on a thread of
+  its own (see pipeline.h). All bookkeeping (the ID table, roots and
+  branches) stays on the thread calling check and uses the claimed
+  conclusion of a rule right away, so a pending check only needs its
+  antecedents and the substitution it was parsed under, which it holds by
+  reference count. Deleting or overwriting an ID thus never has to wait
+  for a check. Pending checks are retired in line order and drained
+  before any error or branch output, so the first failing line is
+  reported exactly as in sequential mode. The threads working for a
+  check take over the arithmetic settings of the checker, i.e. its
+  modulus, with every task (see ArithmeticContext).
+
+  With '--probabilistic K' over a prime modulus the products are not
+  expanded at all. Both sides of a '%' rule are evaluated at K random
+  points instead (Schwartz-Zippel), using cached evaluations of the
+  antecedents. A nonzero difference of degree d vanishes at a random
+  point with probability at most d / modulus.
+
+  Part of Pacheck 3.0 : PAC proof checker.
+*/
+/*------------------------------------------------------------------------*/
+#include "checker.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <iomanip>
+#include <iterator>
+#include <sstream>
+#include "binary.h"
+#include "kernels.h"
+#include "memory.h"
+#include "pipeline.h"
+/*------------------------------------------------------------------------*/
+
+bool nextProofLine(ProofReader& reader, std::string_view& line) {
+  while (reader.nextLine(line)) {
+    if (!line.empty() && line[0] != 'c') return true;
+  }
+  return false;
+}
+
+bool scanProof(const std::string& path, LastMentions* last, ProofCone* cone,
+               std::string& error) {
+  ProofReader reader;
+  if (!reader.open(path)) {
+    error = reader.error();
+    return false;
+  }
+  RuleIds ids;
+  auto record = [&](int lineno) {
+    if (last) recordMentions(ids, lineno, *last);
+    if (cone) cone->record(ids, lineno);
+  };
+  if (reader.startsWith(binary_proof_magic)) {
+    // malformed proofs are reported by the check
+    BinaryProofReader binary(reader);
+    binary.skipPolynomials();
+    for (int i = 1;; ++i) {
+      ArenaScope scratch;
+      Rule rule;
+      if (!binary.next(rule)) break;
+      ruleIds(rule, ids);
+      record(i);
+    }
+  } else {
+    std::string_view line;
+    for (int i = 1; nextProofLine(reader, line); ++i) {
+      if (scanRuleIds(line, ids)) record(i);
+    }
+  }
+  if (cone) cone->close();
+  error = reader.error();
+  return error.empty();
+}
+/*------------------------------------------------------------------------*/
+
+Checker::Checker(const CheckerOptions& options, std::ostream& out)
+    : options_(options),
+      out_(out),
+      slowest_rules_(options.profiled_rules),
+      fingerprint_checks_(options.fingerprints && !options.boolean),
+      worst_rule_log2_(-INFINITY),
+      // evaluating is no homomorphism once x^2 = x
+      probabilistic_points_(options.boolean ? 0 : options.probabilistic_points) {
+  if (probabilistic_points_) random_generator_.seed(std::random_device{}());
+  if (options.threads > 1) {
+    pool_.reset(new ThreadPool(options.threads));
+    max_pending_ = 8 * options.threads;
+  }
+}
+
+Checker::~Checker() {}
+
+static CheckResult failure(const ProofError& error) {
+  return {false, error.lineno, error.message, error.diagnostics};
+}
+
+CheckResult Checker::check(const std::string& path) {
+  ProofReader reader;
+  if (!reader.open(path)) {
+    return failure(proofError(0, "Cannot open file " + path + " (" + reader.error() + ")"));
+  }
+  if (options_.eager_delete || options_.backward) {
+    LastMentions last;
+    std::unique_ptr<ProofCone> cone;
+    if (options_.backward) cone.reset(new ProofCone);
+    std::string error;
+    if (!scanProof(path, options_.eager_delete ? &last : nullptr, cone.get(), error)) {
+      return failure(proofError(0, "Cannot read file " + path + " (" + error + ")"));
+    }
+    if (options_.eager_delete) setEagerDeletion(std::move(last));
+    if (cone) setCone(std::move(cone));
+  }
+  return check(reader, path);
+}
+
+CheckResult Checker::check(ProofReader& reader, const std::string& name) {
+  // starts from the modulus of the calling thread, which is restored
+  ArithmeticContext context = ArithmeticContext::current();
+  context.fingerprints = fingerprint_checks_;
+  context.idempotent = options_.boolean;
+  context.multiply_pool = pool_.get();
+  ArithmeticScope arithmetic(context);
+  try {
+    binary_ = reader.startsWith(binary_proof_magic);
+    if (!options_.resume.empty()) restoreCheckpoint(binary_);
+    std::string error = checkRules(reader);
+    finishPendingChecks();
+    if (!reader.error().empty()) error = reader.error();
+    if (!error.empty()) throw proofError(0, "Cannot read file " + name + " (" + error + ")");
+    if (!options_.target.empty()) checkTarget();
+    if (!checkpoint_writer_.finish()) {
+      throw proofError(0, "Cannot write checkpoint (" + checkpoint_writer_.error() + ")");
+    }
+    // the proof is checked, there is nothing left to resume
+    if (checkpoint_writer_.checkpoints()) remove(options_.checkpoint.c_str());
+  } catch (ProofError& error) {
+    // a failing check of an earlier line is reported instead
+    try {
+      finishPendingChecks();
+    } catch (ProofError& earlier) {
+      return failure(earlier);
+    }
+    return failure(error);
+  }
+  proof_bytes_ = reader.bytesRead();
+  return {true, 0, "", ""};
+}
+
+/// compares the conclusion of the last '%' rule with the target
+void Checker::checkTarget() {
+  Polynomial target;
+  try {
+    target = parsePolynomial(options_.target);
+  } catch (const ProofError& error) {
+    throw proofError(0, "Invalid target polynomial: " + error.message);
+  }
+  if (!last_conclusion_) throw proofError(0, "No linear combination derives the target polynomial");
+  if (*last_conclusion_ != target) {
+    std::ostringstream details;
+    printMismatch(details, *last_conclusion_, target, Substitution());
+    throw proofError(last_conclusion_line_, "Conclusion does not match the target polynomial",
+                     details.str());
+  }
+  out_ << "Target polynomial derived in line " << last_conclusion_line_ << "\n";
+}
+
+/// processes the rules after the checkpoint resumed from, if any,
+/// returns the error of decoding a binary proof
+std::string Checker::checkRules(ProofReader& reader) {
+  const RuleSink process = [this](Rule& rule, int lineno) { processRule(rule, lineno); };
+  const int first = first_lineno_;
+  if (binary_) {
+    BinaryProofReader binary(reader);
+    // records have no offsets, those before the checkpoint are decoded
+    // without their polynomials
+    binary.skipPolynomials();
+    for (int i = 1; i < first; ++i) {
+      ArenaScope scratch;
+      Rule rule;
+      if (!binary.next(rule)) {
+        if (!binary.error().empty()) return binary.error();
+        throw proofError(0, "Checkpoint does not match the proof");
+      }
+    }
+    binary.skipPolynomials(false);
+    if (pool_) {
+      checkPipelined([&binary](Rule& rule, int) { return binary.next(rule); }, process, first);
+    } else {
+      for (int i = first;; ++i) {
+        ArenaScope scratch;  // as in processLine
+        PhaseScope phase(Phase::Parse);
+        Rule rule;
+        if (!binary.next(rule)) break;
+        processRule(rule, i);
+      }
+    }
+    return binary.error();
+  }
+  if (first > 1 && !reader.skipTo(resume_offset_)) {
+    if (!reader.error().empty()) return "";
+    throw proofError(0, "Checkpoint does not match the proof");
+  }
+  if (pool_) {
+    checkPipelined(
+        [&reader](Rule& rule, int lineno) {
+          std::string_view line;
+          if (!nextProofLine(reader, line)) return false;
+          parseLine(line, lineno, rule);
+          rule.end = reader.bytesRead();
+          return true;
+        },
+        process, first);
+  } else {
+    std::string_view line;
+    for (int i = first; nextProofLine(reader, line); ++i) processLine(line, i, reader.bytesRead());
+  }
+  return "";
+}
+/*------------------------------------------------------------------------*/
+// Pending checks of linear combinations
+
+/// a parsed '%' rule whose sum of products still has to be compared
+struct Checker::LinCombCheck {
+  int lineno;
+  int target_id;
+  std::vector<std::pair<PolynomialRef, Polynomial>> products;  // antecedent, multiplier
+  PolynomialRef expected;
+  std::shared_ptr<SubstitutionLevel> level;  // substitution parsed under
+  Polynomial computed;  // reduced by 'level', kept for the error message
+  double seconds = 0;   // checking time, if profiling
+  bool by_fingerprint = false;  // accepted by fingerprints alone
+  uint32_t max_degree = 0;      // of the products, if accepted by fingerprints
+  bool failed = false;
+  std::exception_ptr error;  // thrown by the check, e.g. out of memory
+  std::atomic<bool> done{false};
+};
+
+/// polynomials are sorted by degree first
+static uint32_t degree(const Polynomial& p) { return p.empty() ? 0 : p[0].mono.degree(); }
+
+/// accounts for a rule accepted at 'points' random points with
+/// coordinates drawn from 2^sample_log2 residues, which is wrong with
+/// probability at most (max_degree / 2^sample_log2)^points
+void Checker::countEvaluatedRule(uint32_t max_degree, unsigned points, double sample_log2) {
+  if (max_degree == 0) return;
+  double rule_log2 = points * (std::log2(max_degree) - sample_log2);
+  worst_rule_log2_ = std::max(worst_rule_log2_, std::min(rule_log2, 0.0));
+}
+
+/// whether the fingerprints of both sides agree, which only takes the
+/// fingerprints of the reduced antecedents, multipliers and conclusion
+bool Checker::fingerprintsAgree(LinCombCheck& check) {
+  SubstitutionLevel& level = *check.level;
+  Coeff sum = 0;
+  check.max_degree = degree(*check.expected);
+  for (const auto& [base, multiplier] : check.products) {
+    if (level.empty()) {
+      sum = addCoeff(sum, mulCoeff(base->fingerprint(), multiplier.fingerprint()));
+    } else {
+      sum = addCoeff(sum, mulCoeff(level.reduce(base)->fingerprint(),
+                                   level.reduce(multiplier).fingerprint()));
+    }
+    check.max_degree = std::max(check.max_degree, degree(*base) + degree(multiplier));
+  }
+  return sum == level.reduce(check.expected, false)->fingerprint();
+}
+
+/// both sides are compared after substitution, and since substituting
+/// is a ring homomorphism the sum of products is formed from the reduced
+/// antecedents and multipliers, where antecedents are cached per level,
+/// with fingerprint checks the sum is only formed to report a mismatch
+void Checker::runCheck(LinCombCheck& check) {
+  const uint64_t start = profilingEnabled() ? nanoseconds() : 0;
+  ArenaScope scratch;
+  PhaseScope phase(Phase::Check);
+  SubstitutionLevel& level = *check.level;
+  if (fingerprint_checks_ && fingerprintsAgree(check)) {
+    check.by_fingerprint = true;
+    check.products.clear();
+    if (start) check.seconds = secondsSince(start);
+    check.done.store(true, std::memory_order_release);
+    return;
+  }
+  PolynomialAccumulator sum;
+  uint64_t products = 0;
+  for (const auto& [base, multiplier] : check.products) {
+    if (level.empty()) {
+      products += base->size() * multiplier.size();
+      sum.add(multiplyPolynomials(*base, multiplier));
+    } else {
+      PolynomialRef reduced_base = level.reduce(base);
+      Polynomial reduced_multiplier = level.reduce(multiplier);
+      products += reduced_base->size() * reduced_multiplier.size();
+      sum.add(multiplyPolynomials(*reduced_base, reduced_multiplier));
+    }
+  }
+  check.products.clear();
+  monomial_products_.fetch_add(products, std::memory_order_relaxed);
+
+  check.computed = sum.sum();
+  PolynomialRef expected = level.reduce(check.expected, false);
+  {
+    OperationScope scope(Operation::Compare);
+    check.failed = check.computed != *expected;
+  }
+  if (!check.failed) check.computed = Polynomial();
+  else check.computed.makePersistent();  // kept beyond the scratch arena
+  if (start) check.seconds = secondsSince(start);
+  check.done.store(true, std::memory_order_release);
+}
+
+/// the error of a failed check, with both sides after substitution
+static ProofError mismatch(int lineno, int target_id, const Polynomial& computed,
+                           const Polynomial& expected, const Substitution& subs) {
+  std::ostringstream details;
+  printMismatch(details, computed, expected, subs);
+  return proofError(lineno, "Mismatch in proof for ID " + std::to_string(target_id),
+                    details.str());
+}
+
+static bool isDone(const std::atomic<bool>& done) {
+  return done.load(std::memory_order_acquire);
+}
+
+/// reports a failed check and counts one accepted by fingerprints, in
+/// line order
+void Checker::retireCheck(const LinCombCheck& check) {
+  if (check.error) std::rethrow_exception(check.error);
+  if (check.failed) {
+    throw mismatch(check.lineno, check.target_id, check.computed, *check.expected,
+                   check.level->substitution());
+  }
+  if (check.by_fingerprint) {
+    fingerprint_rules_++;
+    // coordinates of the fingerprint point are 64-bit values, so beyond
+    // 64 bits they cover only 2^64 residues
+    countEvaluatedRule(check.max_degree, 1, std::min(modulusLog2(), 64.0));
+  }
+}
+
+/// waits for all pending checks, throwing the error of the first failing
+void Checker::finishPendingChecks() {
+  while (!pending_checks_.empty()) {
+    LinCombCheck& check = *pending_checks_.front();
+    pool_->helpUntil([&check] { return isDone(check.done); });
+    retireCheck(check);
+    slowest_rules_.record(check.lineno, "linear combination", check.seconds);
+    pending_checks_.pop_front();
+  }
+}
+
+/// retires finished checks in line order and bounds the pending ones
+void Checker::retireChecks() {
+  while (!pending_checks_.empty()) {
+    LinCombCheck& check = *pending_checks_.front();
+    if (pending_checks_.size() > max_pending_) {
+      pool_->helpUntil([&check] { return isDone(check.done); });
+    } else if (!isDone(check.done)) {
+      break;
+    }
+    retireCheck(check);
+    slowest_rules_.record(check.lineno, "linear combination", check.seconds);
+    pending_checks_.pop_front();
+  }
+}
+
+void Checker::submitCheck(std::unique_ptr<LinCombCheck> check) {
+  if (!pool_) {
+    runCheck(*check);
+    retireCheck(*check);
+    return;
+  }
+  // multipliers live in the scratch arena of the current line
+  for (auto& [base, multiplier] : check->products) multiplier.makePersistent();
+  LinCombCheck* c = check.get();
+  pending_checks_.push_back(std::move(check));
+  pool_->submit([this, c, context = ArithmeticContext::current()] {
+    ArithmeticScope arithmetic(context);
+    try {
+      runCheck(*c);
+    } catch (...) {
+      c->error = std::current_exception();
+      c->done.store(true, std::memory_order_release);
+    }
+  });
+  retireChecks();
+}
+
+std::shared_ptr<SubstitutionLevel>& Checker::currentLevel() {
+  if (substitution_levels_.empty()) {
+    substitution_levels_.push_back(std::make_shared<SubstitutionLevel>());
+  }
+  return substitution_levels_.back();
+}
+
+static bool isSubset(const Substitution& a, const Substitution& b) {
+  for (const auto& [var, value] : a) {
+    auto it = b.find(var);
+    if (it == b.end() || it->second != value) return false;
+  }
+  return true;
+}
+
+/// drops the levels of closed branches and adds one for a new branch,
+/// which extends the current level if only one variable was added
+void Checker::updateLevels() {
+  while (substitution_levels_.size() > 1
+         && !isSubset(currentLevel()->substitution(), current_substitution_)) {
+    substitution_levels_.pop_back();
+  }
+  std::shared_ptr<SubstitutionLevel> top = currentLevel();
+  const Substitution& subs = top->substitution();
+  if (subs == current_substitution_) return;
+
+  std::shared_ptr<SubstitutionLevel> level;
+  if (current_substitution_.size() == subs.size() + 1) {
+    for (const auto& [var, value] : current_substitution_) {
+      if (subs.count(var)) continue;
+      level = std::make_shared<SubstitutionLevel>(top, var, value);
+      if (level->substitution() != current_substitution_) level = nullptr;
+      break;
+    }
+  }
+  if (!level) level = std::make_shared<SubstitutionLevel>(current_substitution_);
+  substitution_levels_.push_back(std::move(level));
+}
+
+void Checker::forgetReduced(const PolynomialRef& p) {
+  for (const auto& level : substitution_levels_) level->forget(p.get());
+}
+/*------------------------------------------------------------------------*/
+// Probabilistic checks of linear combinations
+
+void Checker::substitutionChanged() {
+  updateLevels();
+  substitution_epoch_++;
+}
+
+/// draws values for new variables and applies the current substitution
+void Checker::updatePoints() {
+  const unsigned k = probabilistic_points_;
+  const size_t old_size = random_values_.size();
+  while (random_values_.size() < numVariables() * k) {
+    random_values_.push_back(randomCoeff(random_generator_));
+  }
+  if (points_epoch_ == substitution_epoch_) {
+    point_values_.insert(point_values_.end(), random_values_.begin() + old_size,
+                         random_values_.end());
+    return;
+  }
+  point_values_ = random_values_;
+  for (const auto& [var, value] : current_substitution_) {
+    Coeff c = coeffFromInt(value);
+    for (unsigned i = 0; i < k; ++i) point_values_[var * k + i] = c;
+  }
+  points_epoch_ = substitution_epoch_;
+}
+
+void Checker::evaluate(const Polynomial& p, std::vector<Coeff>& values) const {
+  const unsigned k = probabilistic_points_;
+  values.assign(k, Coeff(0));
+  for (const auto& [mono, coeff] : p) {
+    for (unsigned i = 0; i < k; ++i) {
+      Coeff t = coeff;
+      for (const auto& [var, exp] : mono) {
+        const Coeff& v = point_values_[var * k + i];
+        t = mulCoeff(t, exp == 1 ? v : powCoeff(v, exp));
+      }
+      values[i] = addCoeff(values[i], t);
+    }
+  }
+}
+
+const std::vector<Coeff>& Checker::evaluateCached(const PolynomialRef& p) {
+  Evaluation& e = evaluations_[p.get()];
+  if (e.poly.expired() || e.epoch != substitution_epoch_) {
+    e.poly = p;
+    e.epoch = substitution_epoch_;
+    evaluate(*p, e.values);
+  }
+  return e.values;
+}
+
+void Checker::forgetEvaluation(const PolynomialRef& p) {
+  if (probabilistic_points_) evaluations_.erase(p.get());
+}
+
+/// compares both sides at random points, the exact check only runs to
+/// report a mismatch
+void Checker::checkByEvaluation(LinCombCheck& check) {
+  PhaseScope phase(Phase::Check);
+  updatePoints();
+  const unsigned k = probabilistic_points_;
+  std::vector<Coeff> sum(k, Coeff(0)), values;
+  uint32_t max_degree = degree(*check.expected);
+
+  for (const auto& [base, multiplier] : check.products) {
+    const std::vector<Coeff>& base_values = evaluateCached(base);
+    evaluate(multiplier, values);
+    for (unsigned i = 0; i < k; ++i) sum[i] = addCoeff(sum[i], mulCoeff(base_values[i], values[i]));
+    max_degree = std::max(max_degree, degree(*base) + degree(multiplier));
+  }
+
+  const std::vector<Coeff>& expected_values = evaluateCached(check.expected);
+  if (sum != expected_values) {
+    runCheck(check);
+    retireCheck(check);
+  }
+
+  probabilistic_rules_++;
+  countEvaluatedRule(max_degree, k, modulusLog2());
+}
+/*------------------------------------------------------------------------*/
+// Eager deletion and spilling
+
+/// the polynomial bound to 'id', reloaded if it was spilled, null if
+/// there is none
+const PolynomialRef* Checker::findPolynomial(int id, int lineno) {
+  auto it = id_to_poly_.find(id);
+  if (it == id_to_poly_.end()) {
+    auto slot = spilled_.find(id);
+    if (slot == spilled_.end()) return nullptr;
+    Polynomial poly;
+    if (!spill_file_.read(slot->second, poly)) {
+      throw proofError(lineno, "Cannot reload spilled polynomial ID " + std::to_string(id) + " ("
+                                   + spill_file_.error() + ")");
+    }
+    spilled_.erase(slot);
+    reloaded_polynomials_++;
+    it = id_to_poly_.emplace(id, storePolynomial(std::move(poly))).first;
+  }
+  if (options_.memory_limit) last_access_[id] = lineno;
+  return &it->second;
+}
+
+bool Checker::isBound(int id) const { return id_to_poly_.count(id) || spilled_.count(id); }
+
+/// the slot of 'id' for a new polynomial
+PolynomialRef& Checker::bindPolynomial(int id, int lineno) {
+  if (options_.memory_limit) {
+    spilled_.erase(id);
+    last_access_[id] = lineno;
+  }
+  PolynomialRef& slot = id_to_poly_[id];
+  if (slot) {
+    forgetEvaluation(slot);
+    forgetReduced(slot);
+  }
+  return slot;
+}
+
+/// returns false if no polynomial is bound to 'id'
+bool Checker::unbindPolynomial(int id) {
+  if (options_.memory_limit) last_access_.erase(id);
+  auto it = id_to_poly_.find(id);
+  if (it == id_to_poly_.end()) return spilled_.erase(id);
+  forgetEvaluation(it->second);
+  forgetReduced(it->second);
+  id_to_poly_.erase(it);
+  return true;
+}
+
+/// deletes 'id' if line 'lineno' is the last one mentioning it
+void Checker::deleteIfLastMention(int id, int lineno) {
+  auto it = last_mentions_.find(id);
+  if (it == last_mentions_.end() || it->second != lineno) return;
+  last_mentions_.erase(it);
+  if (unbindPolynomial(id)) eager_deletions_++;
+}
+
+void Checker::deleteDeadAntecedents(const Rule& rule, int lineno) {
+  if (last_mentions_.empty()) return;
+  if (rule.kind == Rule::Root) deleteIfLastMention(rule.id, lineno);
+  if (rule.kind != Rule::LinComb) return;
+  for (const auto& product : rule.products) {
+    if (product.first != rule.id) deleteIfLastMention(product.first, lineno);
+  }
+}
+
+/// spills the least recently used polynomials until the stored ones take
+/// at most three quarters of the limit, so that spilling is rare
+void Checker::spillColdPolynomials() {
+  const size_t limit = options_.memory_limit;
+  std::vector<std::pair<int, int>> cold;  // last access and ID
+  for (const auto& [id, ref] : id_to_poly_) cold.emplace_back(last_access_[id], id);
+  std::sort(cold.begin(), cold.end());
+  for (const auto& [line, id] : cold) {
+    if (storedBytes() <= limit / 4 * 3) break;
+    auto it = id_to_poly_.find(id);
+    forgetEvaluation(it->second);
+    forgetReduced(it->second);
+    // shared with pending checks or other IDs, spilling would not free it
+    if (it->second.use_count() > 1) continue;
+    SpillSlot slot;
+    if (!spill_file_.write(*it->second, slot)) {
+      throw proofError(0, "Cannot spill polynomials to disk (" + spill_file_.error() + ")");
+    }
+    spilled_.emplace(id, slot);
+    id_to_poly_.erase(it);
+    spilled_polynomials_++;
+  }
+}
+/*------------------------------------------------------------------------*/
+void Checker::handleModRule(std::string_view digits, int lineno) {
+  if (mod_set_) throw proofError(lineno, "'mod' rule already set.");
+  if (!setModulus(digits)) {
+    throw proofError(lineno, "modulus " + std::string(digits)
+                                 + " is not supported by this build (configure with '--gmp').");
+  }
+  mod_set_ = true;
+  modulus_digits_ = digits;
+  modulusSet();
+}
+
+/// checks linear combinations exactly unless the modulus is prime
+void Checker::modulusSet() {
+  if ((probabilistic_points_ || fingerprint_checks_) && !modulusIsPrime()) {
+    out_ << "Modulus is not prime, checking linear combinations exactly.\n";
+    probabilistic_points_ = 0;
+    fingerprint_checks_ = false;
+    setFingerprints(false);
+  }
+}
+
+/*------------------------------------------------------------------------*/
+void Checker::handleAxiomRule(int id, Polynomial poly, int lineno) {
+  if (isBound(id)) {
+    throw proofError(lineno, "Axiom rule ID " + std::to_string(id) + " already exists.");
+  }
+  if (!mod_set_) throw proofError(lineno, "'mod' rule must be set before axiom rules.");
+
+  for (Var v : getVariables(poly)) {
+    if (v >= allowed_variables_.size()) allowed_variables_.resize(v + 1);
+    allowed_variables_[v] = true;
+  }
+  bindPolynomial(id, lineno) = storePolynomial(std::move(poly));
+}
+
+/*------------------------------------------------------------------------*/
+void Checker::handleDeleteRule(int id, int lineno) {
+  if (!unbindPolynomial(id)) throw proofError(lineno, "Delete rule for unknown ID.");
+}
+
+/*------------------------------------------------------------------------*/
+/// 'products' are pairs of antecedent IDs and multipliers
+void Checker::handleLinCombRule(int target_id, std::vector<std::pair<int, Polynomial>>& products,
+                                Polynomial result, int lineno) {
+  std::unique_ptr<LinCombCheck> check(new LinCombCheck);
+  check->lineno = lineno;
+  check->target_id = target_id;
+
+  for (auto& [poly_id, multiplier] : products) {
+    const PolynomialRef* antecedent = findPolynomial(poly_id, lineno);
+    if (!antecedent) {
+      throw proofError(lineno, "Unknown polynomial ID " + std::to_string(poly_id));
+    }
+    if (!allVariablesAllowed(multiplier, allowed_variables_)) {
+      throw proofError(lineno, "Invalid multiplier introduces new variables");
+    }
+    check->products.emplace_back(*antecedent, std::move(multiplier));
+  }
+
+  PolynomialRef expected = storePolynomial(std::move(result));
+  check->expected = expected;
+  check->level = currentLevel();
+  if (cone_ && !cone_->needed(lineno)) {
+    unverified_rules_++;  // the claimed conclusion is bound all the same
+  } else if (probabilistic_points_) {
+    checkByEvaluation(*check);
+  } else {
+    submitCheck(std::move(check));
+  }
+  if (!options_.target.empty() || options_.checkpoint_every) {
+    last_conclusion_ = expected;
+    last_conclusion_line_ = lineno;
+  }
+
+  PolynomialRef reduced = currentLevel()->reduce(expected, false);
+  bool derived_one;
+  {
+    OperationScope scope(Operation::Compare);
+    derived_one = *reduced == makePolynomial(1);
+  }
+  bindPolynomial(target_id, lineno) = std::move(expected);
+
+  if (derived_one) {
+    finishPendingChecks();  // closing branches is a barrier
+    while (!substitution_stack_.empty()) {
+      auto [var, value] = substitution_stack_.back();
+      substitution_stack_.pop_back();
+      declared_roots_[var].erase(value);
+      const std::string& name = variableName(var);
+      out_ << "Derived 1 under assumption " << name << " = " << value << "\n";
+      out_ << "Removed root " << value << " for variable " << name << "\n";
+
+      if (declared_roots_[var].empty()) {
+        out_ << "▶ All roots for variable " << name << " resolved — closing branch.\n";
+        declared_roots_.erase(var);
+        current_substitution_.clear();
+        for (const auto& [v, val] : substitution_stack_) {
+          current_substitution_[v] = val;
+        }
+      } else {
+        out_ << "Remaining roots for variable " << name << ": ";
+        for (int root : declared_roots_[var]) {
+          out_ << root << " ";
+        }
+        out_ << "\n";
+        break;
+      }
+    }
+    substitutionChanged();
+
+    if (declared_roots_.empty()) {
+      out_ << "No active substitutions left.\n";
+    } else {
+      out_ << "Active substitutions: ";
+      for (const auto& [var, val] : substitution_stack_) {
+        out_ << variableName(var) << "=" << val << " ";
+      }
+      out_ << "\n";
+    }
+  }
+}
+
+/*------------------------------------------------------------------------*/
+void Checker::handleRootRule(int id, Var var, std::string_view name,
+                             const std::vector<int>& roots, int lineno) {
+  const PolynomialRef* found = findPolynomial(id, lineno);
+  if (!found) {
+    throw proofError(lineno, "Unknown polynomial ID " + std::to_string(id) + " in root rule.");
+  }
+
+  // one pass checks the variables, then all roots are evaluated at once
+  UnivariateTerms terms;
+  if (!univariateTerms(**found, var, terms)) {
+    throw proofError(lineno, "Polynomial ID " + std::to_string(id)
+                                 + " is not univariate in variable '" + std::string(name) + "'");
+  }
+  std::vector<Coeff> points, values;
+  points.reserve(roots.size());
+  for (int root : roots) points.push_back(coeffFromInt(root));
+  evaluateUnivariate(terms, points, values);
+
+  for (size_t i = 0; i < roots.size(); ++i) {
+    if (values[i] != 0) {
+      throw proofError(lineno, std::to_string(roots[i]) + " is not a root of polynomial ID "
+                                   + std::to_string(id));
+    }
+    declared_roots_[var].insert(roots[i]);
+  }
+}
+
+/*------------------------------------------------------------------------*/
+void Checker::handleBranchRule(Var var, std::string_view name, int value, int lineno) {
+  if (declared_roots_.count(var) == 0 || declared_roots_[var].count(value) == 0) {
+    throw proofError(lineno, "Instantiation of " + std::string(name) + " = "
+                                 + std::to_string(value) + " is invalid — root not declared.");
+  }
+
+  finishPendingChecks();  // branching is a barrier
+  substitution_stack_.emplace_back(var, value);
+  current_substitution_[var] = value;
+  substitutionChanged();
+
+  out_ << "Branch on " << name << " = " << value << std::endl;
+}
+
+/*------------------------------------------------------------------------*/
+void Checker::applyRule(Rule& rule, int lineno) {
+  switch (rule.kind) {
+    case Rule::Mod:
+      handleModRule(rule.text, lineno);
+      break;
+    case Rule::Axiom:
+      handleAxiomRule(rule.id, std::move(rule.poly), lineno);
+      axiom_rules_++;
+      break;
+    case Rule::Delete:
+      handleDeleteRule(rule.id, lineno);
+      delete_rules_++;
+      break;
+    case Rule::LinComb:
+      handleLinCombRule(rule.id, rule.products, std::move(rule.poly), lineno);
+      lincomb_rules_++;
+      break;
+    case Rule::Root:
+      handleRootRule(rule.id, rule.var, rule.text, rule.values, lineno);
+      root_rules_++;
+      break;
+    case Rule::Branch:
+      handleBranchRule(rule.var, rule.text, rule.values[0], lineno);
+      branch_rules_++;
+      break;
+  }
+}
+
+static const char* ruleKindName(Rule::Kind kind) {
+  switch (kind) {
+    case Rule::Mod: return "modulus";
+    case Rule::Axiom: return "axiom";
+    case Rule::Delete: return "delete";
+    case Rule::LinComb: return "linear combination";
+    case Rule::Root: return "root";
+    default: return "branch";
+  }
+}
+
+void Checker::processRule(Rule& rule, int lineno) {
+  const uint64_t start = nanoseconds();
+  applyRule(rule, lineno);
+  deleteDeadAntecedents(rule, lineno);
+  if (options_.memory_limit && storedBytes() > options_.memory_limit) spillColdPolynomials();
+  const double seconds = secondsSince(start);
+  rule_seconds_[rule.kind] += seconds;
+  // pending checks are recorded when they are retired
+  const bool pending = rule.kind == Rule::LinComb && pool_ && !probabilistic_points_;
+  if (!pending) slowest_rules_.record(lineno, ruleKindName(rule.kind), seconds);
+  if (options_.checkpoint_every && lineno % options_.checkpoint_every == 0) {
+    writeCheckpoint(rule, lineno);
+  }
+}
+
+/// parses and processes a line in a scratch arena scope of its own,
+/// 'end' is the number of bytes of the proof up to its end
+void Checker::processLine(std::string_view line, int lineno, size_t end) {
+  ArenaScope scratch;  // temporaries of the line are released in bulk
+  PhaseScope phase(Phase::Parse);
+  Rule rule;
+  parseLine(line, lineno, rule);
+  rule.end = end;
+  processRule(rule, lineno);
+}
+/*------------------------------------------------------------------------*/
+// Checkpoints
+
+CheckpointCounters Checker::counters() const {
+  CheckpointCounters c;
+  c.rules[Rule::Axiom] = axiom_rules_;
+  c.rules[Rule::Delete] = delete_rules_;
+  c.rules[Rule::LinComb] = lincomb_rules_;
+  c.rules[Rule::Root] = root_rules_;
+  c.rules[Rule::Branch] = branch_rules_;
+  std::copy(std::begin(rule_seconds_), std::end(rule_seconds_), c.rule_seconds);
+  c.unverified_rules = unverified_rules_;
+  c.fingerprint_rules = fingerprint_rules_;
+  c.probabilistic_rules = probabilistic_rules_;
+  c.worst_rule_log2 = worst_rule_log2_;
+  c.monomial_products = monomial_products_;
+  c.eager_deletions = eager_deletions_;
+  return c;
+}
+
+/// takes a snapshot after rule 'lineno' once all earlier rules are
+/// verified, which is written in the background
+void Checker::writeCheckpoint(const Rule& rule, int lineno) {
+  finishPendingChecks();
+  CheckpointState state;
+  state.lineno = lineno;
+  state.offset = rule.end;
+  state.binary = binary_;
+  state.modulus = modulus_digits_;
+  state.boolean = options_.boolean;
+  state.polynomials.assign(id_to_poly_.begin(), id_to_poly_.end());
+  state.spilled.assign(spilled_.begin(), spilled_.end());
+  for (Var v = 0; v < allowed_variables_.size(); ++v) {
+    if (allowed_variables_[v]) state.allowed_variables.push_back(v);
+  }
+  state.substitution_stack = substitution_stack_;
+  state.current_substitution.assign(current_substitution_.begin(), current_substitution_.end());
+  for (const auto& [var, roots] : declared_roots_) {
+    state.declared_roots.emplace_back(var, std::vector<int>(roots.begin(), roots.end()));
+  }
+  state.last_conclusion = last_conclusion_;
+  state.last_conclusion_line = last_conclusion_line_;
+  state.counters = counters();
+  if (!checkpoint_writer_.write(options_.checkpoint, std::move(state), spill_file_)) {
+    throw proofError(0, "Cannot write checkpoint (" + checkpoint_writer_.error() + ")");
+  }
+}
+
+/// continues after the checkpoint given by the options
+void Checker::restoreCheckpoint(bool binary) {
+  const std::string& path = options_.resume;
+  CheckpointState state;
+  std::string error;
+  // restored polynomials are stored with fingerprints only if checks
+  // by fingerprints remain on for this modulus
+  const auto header = [this, binary](const CheckpointState& state) {
+    if (state.binary != binary) throw proofError(0, "Checkpoint does not match the proof");
+    if (state.boolean != options_.boolean) {
+      throw proofError(0, std::string("Checkpoint was written ")
+                              + (state.boolean ? "with" : "without") + " '--boolean'");
+    }
+    if (!state.modulus.empty()) {
+      mod_set_ = true;
+      modulus_digits_ = state.modulus;
+      modulusSet();
+    }
+  };
+  if (!readCheckpoint(path, state, error, header)) {
+    throw proofError(0, "Cannot read checkpoint " + path + " (" + error + ")");
+  }
+  for (auto& [id, poly] : state.polynomials) {
+    if (options_.memory_limit) last_access_[id] = state.lineno;
+    id_to_poly_[id] = std::move(poly);
+  }
+  for (Var v : state.allowed_variables) {
+    if (v >= allowed_variables_.size()) allowed_variables_.resize(v + 1);
+    allowed_variables_[v] = true;
+  }
+  substitution_stack_ = std::move(state.substitution_stack);
+  current_substitution_.insert(state.current_substitution.begin(),
+                               state.current_substitution.end());
+  for (const auto& [var, roots] : state.declared_roots) {
+    declared_roots_[var].insert(roots.begin(), roots.end());
+  }
+  substitutionChanged();
+  last_conclusion_ = std::move(state.last_conclusion);
+  last_conclusion_line_ = state.last_conclusion_line;
+
+  const CheckpointCounters& c = state.counters;
+  axiom_rules_ = c.rules[Rule::Axiom];
+  delete_rules_ = c.rules[Rule::Delete];
+  lincomb_rules_ = c.rules[Rule::LinComb];
+  root_rules_ = c.rules[Rule::Root];
+  branch_rules_ = c.rules[Rule::Branch];
+  std::copy(std::begin(c.rule_seconds), std::end(c.rule_seconds), rule_seconds_);
+  unverified_rules_ = c.unverified_rules;
+  fingerprint_rules_ = c.fingerprint_rules;
+  probabilistic_rules_ = c.probabilistic_rules;
+  worst_rule_log2_ = c.worst_rule_log2;
+  monomial_products_ = c.monomial_products;
+  eager_deletions_ = c.eager_deletions;
+
+  first_lineno_ = state.lineno + 1;
+  resume_offset_ = state.offset;
+  out_ << "Resuming after line " << state.lineno << " from checkpoint " << path << "\n";
+}
+/*------------------------------------------------------------------------*/
+
+static const Rule::Kind counted_kinds[] = {Rule::Axiom, Rule::LinComb, Rule::Delete, Rule::Root,
+                                           Rule::Branch};
+
+/// 'name' with spaces replaced, as a JSON key
+static std::string jsonKey(const char* name) {
+  std::string key = name;
+  std::replace(key.begin(), key.end(), ' ', '_');
+  return "\"" + key + "\"";
+}
+
+/// the statistics as one JSON object, keys as in the text report
+void Checker::printStatisticsJson(std::ostream& out) const {
+  const int rules[] = {axiom_rules_, lincomb_rules_, delete_rules_, root_rules_, branch_rules_};
+  const char* sep = "";
+  out << "{\n  \"rules\": {";
+  for (size_t i = 0; i < std::size(counted_kinds); ++i) {
+    out << sep << jsonKey(ruleKindName(counted_kinds[i])) << ": " << rules[i];
+    sep = ", ";
+  }
+  out << "},\n  \"rule_seconds\": {";
+  sep = "";
+  for (Rule::Kind kind : counted_kinds) {
+    out << sep << jsonKey(ruleKindName(kind)) << ": " << rule_seconds_[kind];
+    sep = ", ";
+  }
+  StoreStatistics store = storeStatistics();
+  out << "},\n  \"monomial_products\": " << monomial_products_ << ",\n"
+      << "  \"store\": {\"stored\": " << store.stored << ", \"shared\": " << store.shared
+      << ", \"alive\": " << store.alive << ", \"peak\": " << store.peak
+      << ", \"terms\": " << store.terms << "},\n"
+      << "  \"monomials\": {\"alive\": " << store.monomials
+      << ", \"peak\": " << store.monomials_peak << "},\n"
+      << "  \"max_degree\": " << store.max_degree << ",\n"
+      << "  \"kernels\": " << jsonKey(factor_kernels->name) << ",\n"
+      << "  \"proof_bytes\": " << proof_bytes_ << ",\n"
+      << "  \"peak_rss_kb\": " << peakResidentSetSize() << ",\n"
+      << "  \"process_seconds\": " << processSeconds() << ",\n"
+      << "  \"allocations\": {";
+  sep = "";
+  for (Phase phase : {Phase::Parse, Phase::Check, Phase::Store, Phase::Other}) {
+    AllocationCounts counts = allocationCounts(phase);
+    out << sep << "\n    " << jsonKey(phaseName(phase)) << ": {\"heap\": "
+        << counts.heap_allocations << ", \"heap_bytes\": " << counts.heap_bytes
+        << ", \"arena\": " << counts.arena_allocations
+        << ", \"arena_bytes\": " << counts.arena_bytes << "}";
+    sep = ",";
+  }
+  out << "\n  },\n"
+      << "  \"substituted_antecedents\": {\"computed\": " << SubstitutionLevel::misses()
+      << ", \"reused\": " << SubstitutionLevel::hits() << "},\n"
+      << "  \"eager_deletions\": " << eager_deletions_ << ",\n"
+      << "  \"spill\": {\"spilled\": " << spilled_polynomials_
+      << ", \"reloaded\": " << reloaded_polynomials_
+      << ", \"bytes\": " << spill_file_.bytesWritten() << "},\n"
+      << "  \"checkpoints\": {\"written\": " << checkpoint_writer_.checkpoints()
+      << ", \"last_bytes\": " << checkpoint_writer_.bytesWritten() << "},\n"
+      << "  \"operations\": {";
+  sep = "";
+  for (int i = 0; i < num_operations; ++i) {
+    const Operation op = static_cast<Operation>(i);
+    OperationCounts counts = operationCounts(op);
+    out << sep << "\n    " << jsonKey(operationName(op)) << ": {\"calls\": " << counts.calls
+        << ", \"seconds\": " << counts.seconds << "}";
+    sep = ",";
+  }
+  out << "\n  },\n"
+      << "  \"probabilistic\": {\"points\": " << probabilistic_points_
+      << ", \"rules\": " << probabilistic_rules_ << "},\n"
+      << "  \"fingerprint_rules\": " << fingerprint_rules_ << ",\n"
+      << "  \"unverified_rules\": " << unverified_rules_ << ",\n"
+      << "  \"slowest_rules\": [";
+  sep = "";
+  for (const RuleTime& rule : slowest_rules_.rules()) {
+    out << sep << "\n    {\"line\": " << rule.lineno << ", \"kind\": \"" << rule.kind
+        << "\", \"seconds\": " << rule.seconds << "}";
+    sep = ",";
+  }
+  out << (*sep ? "\n  ]\n}\n" : "]\n}\n");
+}
+
+void Checker::printStatistics(std::ostream& out, bool json) const {
+  if (json) {
+    printStatisticsJson(out);
+    return;
+  }
+  out << "  Axiom rules processed: " << axiom_rules_ << "\n";
+  out << "  Linear combination rules processed: " << lincomb_rules_ << "\n";
+  out << "  Branch rules processed: " << branch_rules_ << "\n";
+  out << "  Delete rules processed: " << delete_rules_ << "\n";
+  out << "  Root rules processed: " << root_rules_ << "\n";
+  out << "  Time per rule type: " << std::fixed << std::setprecision(4)
+      << "axiom " << rule_seconds_[Rule::Axiom] << " s, linear combination "
+      << rule_seconds_[Rule::LinComb] << " s, delete " << rule_seconds_[Rule::Delete]
+      << " s, root " << rule_seconds_[Rule::Root] << " s, branch "
+      << rule_seconds_[Rule::Branch] << " s\n";
+  out.unsetf(std::ios::floatfield);
+  out << std::setprecision(6);
+  if (monomial_products_) {
+    out << "  Monomial products formed: " << monomial_products_ << "\n";
+  }
+
+  StoreStatistics store = storeStatistics();
+  out << "  Polynomials stored: " << store.stored << " (" << store.shared
+      << " shared with an identical one, at most " << store.peak << " distinct alive)\n";
+  out << "  Interned monomials alive: " << store.monomials << " (at most "
+      << store.monomials_peak << ")\n";
+  out << "  Proof size: " << proof_bytes_ << " bytes, " << store.terms
+      << " monomials stored, maximum degree " << store.max_degree << "\n";
+  out << "  Monomial kernels: " << factor_kernels->name << "\n";
+  if (long rss = peakResidentSetSize()) {
+    out << "  Peak memory: " << (rss + 512) / 1024 << " MB\n";
+    out << "  Process time: " << processSeconds() << " s\n";
+  }
+  out << "  Allocations per phase (heap / scratch arena):\n";
+  for (Phase phase : {Phase::Parse, Phase::Check, Phase::Store, Phase::Other}) {
+    AllocationCounts counts = allocationCounts(phase);
+    out << "    " << phaseName(phase) << ": " << counts.heap_allocations << " ("
+        << (counts.heap_bytes >> 20) << " MB) / " << counts.arena_allocations << " ("
+        << (counts.arena_bytes >> 20) << " MB)\n";
+  }
+  out << "  Operations (calls" << (profilingEnabled() ? " / seconds" : "") << "):\n";
+  for (int i = 0; i < num_operations; ++i) {
+    const Operation op = static_cast<Operation>(i);
+    OperationCounts counts = operationCounts(op);
+    out << "    " << operationName(op) << ": " << counts.calls;
+    if (profilingEnabled()) out << " / " << counts.seconds;
+    out << "\n";
+  }
+  if (SubstitutionLevel::hits() + SubstitutionLevel::misses()) {
+    out << "  Substituted antecedents: " << SubstitutionLevel::misses() << " computed, "
+        << SubstitutionLevel::hits() << " reused\n";
+  }
+  if (eager_deletions_) {
+    out << "  Eagerly deleted polynomials: " << eager_deletions_ << "\n";
+  }
+  if (spilled_polynomials_) {
+    out << "  Spilled polynomials: " << spilled_polynomials_ << " ("
+        << (spill_file_.bytesWritten() >> 20) << " MB written), " << reloaded_polynomials_
+        << " reloaded\n";
+  }
+  if (checkpoint_writer_.checkpoints()) {
+    out << "  Checkpoints written: " << checkpoint_writer_.checkpoints() << " (the last one "
+        << checkpoint_writer_.bytesWritten() << " bytes)\n";
+  }
+  if (probabilistic_rules_) {
+    out << "  Linear combination rules checked at " << probabilistic_points_
+        << " random points: " << probabilistic_rules_ << "\n";
+  }
+  if (fingerprint_rules_) {
+    out << "  Linear combination rules checked by fingerprint: " << fingerprint_rules_ << "\n";
+  }
+  if (cone_) {
+    out << "  Linear combination rules outside the cone of the conclusion (not verified): "
+        << unverified_rules_ << "\n";
+  }
+  if (probabilistic_rules_ || fingerprint_rules_) {
+    // union bound over all rules checked by evaluation
+    double bound = worst_rule_log2_ + std::log2(probabilistic_rules_ + fingerprint_rules_);
+    out << "  False accept probability: ";
+    if (worst_rule_log2_ == -INFINITY) out << "0\n";
+    else if (bound >= 0) out << "<= 1 (modulus too small for the degree)\n";
+    else out << "<= 2^" << std::floor(bound * 10) / 10 << "\n";
+  }
+  std::vector<RuleTime> slowest = slowest_rules_.rules();
+  if (!slowest.empty()) {
+    out << "  Slowest rules:\n";
+    for (const RuleTime& rule : slowest) {
+      out << "    line " << rule.lineno << " (" << rule.kind << "): " << rule.seconds
+          << " s\n";
+    }
+  }
+}
@@ -0,0 +1,241 @@
+/*------------------------------------------------------------------------*/
+/*! \file checker.h
+    \brief checking a proof with a state of its own
+
+  A checker holds everything a proof defines: the polynomials bound to
+  IDs, the declared roots and open branches, the modulus, the thread
+  pool for the checks and the statistics of the proof. Checkers are
+  independent of each other, so a process may check many proofs at
+  once, each on a thread of its own. Errors in a proof end its check
+  and are returned as a result instead of ending the process.
+
+  Some parts are shared by all checkers of a process: interned variables
+  and monomials, the store of polynomials (thus the memory limit bounds
+  all stored polynomials), the counters of operations and allocations
+  and the cache statistics of substitutions. They are thread-safe and
+  reported summed over all proofs.
+
+  Part of Pacheck 3.0 : PAC proof checker.
+*/
+/*------------------------------------------------------------------------*/
+#ifndef PACHECK2_SRC_CHECKER_H_
+#define PACHECK2_SRC_CHECKER_H_
+/*------------------------------------------------------------------------*/
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <iostream>
+#include <memory>
+#include <random>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+#include "checkpoint.h"
+#include "cone.h"
+#include "parser.h"
+#include "profile.h"
+#include "reader.h"
+#include "spill.h"
+#include "substitution.h"
+#include "threadpool.h"
+/*------------------------------------------------------------------------*/
+
+struct CheckerOptions {
+  unsigned threads = 1;                // checking '%' rules, parsing ahead if more than one
+  unsigned probabilistic_points = 0;   // checking '%' rules at random points if nonzero
+  bool fingerprints = false;           // checking '%' rules by fingerprints
+  bool eager_delete = false;           // deleting polynomials after their last use
+  size_t memory_limit = 0;             // in bytes of stored polynomials, 0 if none
+  size_t profiled_rules = 0;           // number of slowest rules kept
+  bool backward = false;               // verifying only the cone of the conclusion
+  bool boolean = false;                // variables are Boolean, i.e. x^2 = x, exact checks only
+  std::string target;                  // polynomial the last '%' rule has to conclude, if any
+  size_t checkpoint_every = 0;         // rules between checkpoints, 0 if none
+  std::string checkpoint;              // path checkpoints are written to
+  std::string resume;                  // checkpoint to continue from, if any
+};
+
+struct CheckResult {
+  bool ok = false;
+  int lineno = 0;           // of the failing rule, 0 if the failure is not tied to one
+  std::string message;      // what failed, empty if the proof is correct
+  std::string diagnostics;  // the full error report, e.g. with the mismatching polynomials
+};
+
+/// reads the next line of a textual proof, skipping empty and comment lines
+bool nextProofLine(ProofReader& reader, std::string_view& line);
+
+/// finds the last line mentioning each ID and the cone of the
+/// conclusion, each if not null, in a pass over the proof at 'path',
+/// returns false with the reason in 'error' if it cannot be read
+bool scanProof(const std::string& path, LastMentions* last, ProofCone* cone,
+               std::string& error);
+
+class Checker {
+ public:
+  /// progress messages and statistics are written to 'out'
+  explicit Checker(const CheckerOptions& options = CheckerOptions(),
+                   std::ostream& out = std::cout);
+  ~Checker();
+  Checker(const Checker&) = delete;
+  Checker& operator=(const Checker&) = delete;
+
+  /// checks the textual or binary proof read by 'reader', where 'name'
+  /// names the input in error messages, a checker checks one proof
+  CheckResult check(ProofReader& reader, const std::string& name);
+
+  /// opens and checks the proof at 'path' ("-" for standard input),
+  /// with a pre-pass over the proof for eager deletion
+  CheckResult check(const std::string& path);
+
+  /// deletes each antecedent of a '%' or 'r' rule right after the last
+  /// line mentioning its ID, as if a 'd' rule followed
+  void setEagerDeletion(LastMentions last) { last_mentions_ = std::move(last); }
+
+  /// verifies only the '%' rules in 'cone'
+  void setCone(std::unique_ptr<ProofCone> cone) { cone_ = std::move(cone); }
+
+  /// checks and applies a rule, which has to be allocated within a
+  /// scratch arena scope enclosing the call (see memory.h), errors are
+  /// thrown as ProofError, failed pending checks possibly later
+  void processRule(Rule& rule, int lineno);
+
+  /// reports the statistics of the checked proof to 'out', as one JSON
+  /// object instead of text if 'json'
+  void printStatistics(std::ostream& out, bool json = false) const;
+
+  /// reports the statistics with the progress messages
+  void printStatistics(bool json = false) const { printStatistics(out_, json); }
+
+  /// (decompressed) bytes of the proof, once checked successfully
+  size_t proofBytes() const { return proof_bytes_; }
+
+ private:
+  struct LinCombCheck;
+  struct Evaluation {
+    std::weak_ptr<const Polynomial> poly;  // expires if the address is reused
+    uint64_t epoch;
+    std::vector<Coeff> values;
+  };
+
+  std::string checkRules(ProofReader& reader);
+  void processLine(std::string_view line, int lineno, size_t end);
+  void applyRule(Rule& rule, int lineno);
+
+  void handleModRule(std::string_view digits, int lineno);
+  void modulusSet();
+  void handleAxiomRule(int id, Polynomial poly, int lineno);
+  void handleDeleteRule(int id, int lineno);
+  void handleLinCombRule(int target_id, std::vector<std::pair<int, Polynomial>>& products,
+                         Polynomial result, int lineno);
+  void handleRootRule(int id, Var var, std::string_view name, const std::vector<int>& roots,
+                      int lineno);
+  void handleBranchRule(Var var, std::string_view name, int value, int lineno);
+
+  // pending checks of linear combinations
+  void countEvaluatedRule(uint32_t max_degree, unsigned points, double sample_log2);
+  bool fingerprintsAgree(LinCombCheck& check);
+  void runCheck(LinCombCheck& check);
+  void retireCheck(const LinCombCheck& check);
+  void finishPendingChecks();
+  void retireChecks();
+  void submitCheck(std::unique_ptr<LinCombCheck> check);
+
+  // substitutions of open branches
+  std::shared_ptr<SubstitutionLevel>& currentLevel();
+  void updateLevels();
+  void forgetReduced(const PolynomialRef& p);
+  void substitutionChanged();
+
+  // probabilistic checks of linear combinations
+  void updatePoints();
+  void evaluate(const Polynomial& p, std::vector<Coeff>& values) const;
+  const std::vector<Coeff>& evaluateCached(const PolynomialRef& p);
+  void forgetEvaluation(const PolynomialRef& p);
+  void checkByEvaluation(LinCombCheck& check);
+
+  // eager deletion and spilling
+  const PolynomialRef* findPolynomial(int id, int lineno);
+  bool isBound(int id) const;
+  PolynomialRef& bindPolynomial(int id, int lineno);
+  bool unbindPolynomial(int id);
+  void deleteIfLastMention(int id, int lineno);
+  void deleteDeadAntecedents(const Rule& rule, int lineno);
+  void spillColdPolynomials();
+
+  // checkpoints
+  CheckpointCounters counters() const;
+  void writeCheckpoint(const Rule& rule, int lineno);
+  void restoreCheckpoint(bool binary);
+
+  void checkTarget();
+  void printStatisticsJson(std::ostream& out) const;
+
+  const CheckerOptions options_;
+  std::ostream& out_;
+
+  std::unordered_map<int, PolynomialRef> id_to_poly_;
+  std::vector<bool> allowed_variables_;  // indexed by variable
+  std::vector<std::pair<Var, int>> substitution_stack_;
+  std::unordered_map<Var, std::unordered_set<int>> declared_roots_;
+  Substitution current_substitution_;  // of the open branches
+  bool mod_set_ = false;
+  std::string modulus_digits_;  // of the 'm' rule
+  PolynomialRef last_conclusion_;  // of the last '%' rule, with a target
+  int last_conclusion_line_ = 0;
+  size_t proof_bytes_ = 0;
+
+  int axiom_rules_ = 0;
+  int lincomb_rules_ = 0;
+  int branch_rules_ = 0;
+  int delete_rules_ = 0;
+  int root_rules_ = 0;
+  double rule_seconds_[Rule::Branch + 1] = {};  // on the main thread, per kind
+  SlowestRules slowest_rules_;
+
+  std::deque<std::unique_ptr<LinCombCheck>> pending_checks_;  // in line order
+  size_t max_pending_ = 0;                                    // bound on parsing ahead
+  std::atomic<uint64_t> monomial_products_{0};                // multiplied by checks
+
+  /// one level per open branch, the innermost is current
+  std::vector<std::shared_ptr<SubstitutionLevel>> substitution_levels_;
+
+  bool fingerprint_checks_ = false;  // accept by fingerprints alone
+  int fingerprint_rules_ = 0;
+  int probabilistic_rules_ = 0;
+  double worst_rule_log2_;  // log2 of the largest per-rule bound
+
+  unsigned probabilistic_points_ = 0;  // 0 if checking exactly
+  std::mt19937_64 random_generator_;
+  std::vector<Coeff> random_values_;  // 'probabilistic_points_' per variable
+  std::vector<Coeff> point_values_;   // with the substitution applied
+  uint64_t substitution_epoch_ = 1;   // changes with the substitution
+  uint64_t points_epoch_ = 0;         // epoch of 'point_values_'
+  std::unordered_map<const Polynomial*, Evaluation> evaluations_;
+
+  std::unique_ptr<ProofCone> cone_;  // null unless checking backwards
+  int unverified_rules_ = 0;         // '%' rules outside the cone
+
+  LastMentions last_mentions_;  // of antecedents, with eager deletion
+  size_t eager_deletions_ = 0;
+  SpillFile spill_file_;
+  std::unordered_map<int, SpillSlot> spilled_;  // IDs of spilled polynomials
+  std::unordered_map<int, int> last_access_;    // line, with a memory limit
+  size_t spilled_polynomials_ = 0;
+  size_t reloaded_polynomials_ = 0;
+
+  CheckpointWriter checkpoint_writer_;  // destroyed before the spill file it reads
+  bool binary_ = false;                 // the proof is binary
+  int first_lineno_ = 1;                // after the checkpoint resumed from
+  uint64_t resume_offset_ = 0;          // of the first line, in bytes
+
+  /// null when checking sequentially, destroyed first, which waits for
+  /// running checks before what they use goes
+  std::unique_ptr<ThreadPool> pool_;
+};
+
+/*------------------------------------------------------------------------*/
+#endif  // PACHECK2_SRC_CHECKER_H_
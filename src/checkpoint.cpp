@@ -0,0 +1,255 @@
+/*------------------------------------------------------------------------*/
+/*! \file checkpoint.cpp
+    \brief snapshots of the checking state for resuming a check
+
+  Part of Pacheck 3.0 : PAC proof checker.
+*/
+/*------------------------------------------------------------------------*/
+#include "checkpoint.h"
+
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <unistd.h>
+/*------------------------------------------------------------------------*/
+static const char checkpoint_magic[] = "PCKP";
+static const uint8_t checkpoint_version = 1;
+
+static void putSigned(std::vector<uint8_t>& buffer, int64_t value) {
+  putVarint(buffer, (uint64_t(value) << 1) ^ uint64_t(value >> 63));
+}
+
+static void putString(std::vector<uint8_t>& buffer, std::string_view s) {
+  putVarint(buffer, s.size());
+  buffer.insert(buffer.end(), s.begin(), s.end());
+}
+
+static void putDouble(std::vector<uint8_t>& buffer, double value) {
+  uint64_t bits;
+  memcpy(&bits, &value, sizeof bits);
+  putVarint(buffer, bits);
+}
+
+static void encodeCounters(const CheckpointCounters& c, std::vector<uint8_t>& buffer) {
+  for (uint64_t n : c.rules) putVarint(buffer, n);
+  for (double seconds : c.rule_seconds) putDouble(buffer, seconds);
+  putVarint(buffer, c.unverified_rules);
+  putVarint(buffer, c.fingerprint_rules);
+  putVarint(buffer, c.probabilistic_rules);
+  putDouble(buffer, c.worst_rule_log2);
+  putVarint(buffer, c.monomial_products);
+  putVarint(buffer, c.eager_deletions);
+}
+/*------------------------------------------------------------------------*/
+
+bool CheckpointWriter::write(const std::string& path, CheckpointState state,
+                             const SpillFile& spill) {
+  if (!finish()) return false;
+  thread_ = std::thread(&CheckpointWriter::run, this, path, std::move(state), &spill,
+                        ArithmeticContext::current());
+  return true;
+}
+
+bool CheckpointWriter::finish() {
+  if (thread_.joinable()) thread_.join();
+  return error_.empty();
+}
+
+void CheckpointWriter::run(std::string path, CheckpointState state, const SpillFile* spill,
+                           ArithmeticContext context) {
+  ArithmeticScope arithmetic(context);
+  std::vector<uint8_t> buffer(checkpoint_magic, checkpoint_magic + 4);
+  buffer.push_back(checkpoint_version);
+  putVarint(buffer, state.lineno);
+  putVarint(buffer, state.offset);
+  putVarint(buffer, state.binary);
+  putVarint(buffer, state.boolean);
+  putString(buffer, state.modulus);
+
+  // names of all variables, which polynomials refer to by index
+  const size_t variables = numVariables();
+  putVarint(buffer, variables);
+  for (Var v = 0; v < variables; ++v) putString(buffer, variableName(v));
+
+  putVarint(buffer, state.allowed_variables.size());
+  for (Var v : state.allowed_variables) putVarint(buffer, v);
+  for (const auto* assignments : {&state.substitution_stack, &state.current_substitution}) {
+    putVarint(buffer, assignments->size());
+    for (const auto& [var, value] : *assignments) {
+      putVarint(buffer, var);
+      putSigned(buffer, value);
+    }
+  }
+  putVarint(buffer, state.declared_roots.size());
+  for (const auto& [var, roots] : state.declared_roots) {
+    putVarint(buffer, var);
+    putVarint(buffer, roots.size());
+    for (int root : roots) putSigned(buffer, root);
+  }
+  encodeCounters(state.counters, buffer);
+  putVarint(buffer, state.last_conclusion_line);
+  putVarint(buffer, state.last_conclusion != nullptr);
+  if (state.last_conclusion) encodePolynomial(*state.last_conclusion, buffer);
+
+  putVarint(buffer, state.polynomials.size() + state.spilled.size());
+  for (const auto& [id, poly] : state.polynomials) {
+    putSigned(buffer, id);
+    encodePolynomial(*poly, buffer);
+  }
+  state.polynomials.clear();  // releases the snapshot early
+  for (const auto& [id, slot] : state.spilled) {
+    putSigned(buffer, id);
+    if (!spill->readBytes(slot, buffer)) {
+      error_ = "cannot read spilled polynomials";
+      return;
+    }
+  }
+  buffer.insert(buffer.end(), checkpoint_magic, checkpoint_magic + 4);
+
+  const std::string temporary = path + ".tmp";
+  FILE* file = fopen(temporary.c_str(), "wb");
+  errno = 0;
+  bool ok = file && fwrite(buffer.data(), 1, buffer.size(), file) == buffer.size()
+            && fflush(file) == 0 && fsync(fileno(file)) == 0;
+  if (file && fclose(file) != 0) ok = false;
+  if (ok && rename(temporary.c_str(), path.c_str()) != 0) ok = false;
+  if (!ok) {
+    error_ = "cannot write " + path + " (" + (errno ? strerror(errno) : "unknown error") + ")";
+    remove(temporary.c_str());
+    return;
+  }
+  checkpoints_++;
+  bytes_ = buffer.size();
+}
+/*------------------------------------------------------------------------*/
+
+/// decodes a checkpoint held in memory
+struct CheckpointDecoder {
+  const uint8_t* pos;
+  const uint8_t* end;
+  bool ok = true;
+
+  uint64_t number() {
+    uint64_t value = 0;
+    if (ok && !getVarint(pos, end, value)) ok = false;
+    return value;
+  }
+  int64_t signedNumber() {
+    const uint64_t value = number();
+    return static_cast<int64_t>(value >> 1) ^ -static_cast<int64_t>(value & 1);
+  }
+  /// a count of items of at least one byte each, bounded by the input
+  uint64_t count() {
+    const uint64_t n = number();
+    if (n > uint64_t(end - pos)) ok = false;
+    return ok ? n : 0;
+  }
+  std::string string() {
+    const uint64_t n = count();
+    std::string s(reinterpret_cast<const char*>(pos), n);
+    pos += n;
+    return s;
+  }
+  double real() {
+    const uint64_t bits = number();
+    double value;
+    memcpy(&value, &bits, sizeof value);
+    return value;
+  }
+  Var var(const std::vector<Var>& vars) {
+    const uint64_t index = number();
+    if (index >= vars.size()) ok = false;
+    return ok ? vars[index] : 0;
+  }
+  Polynomial polynomial(const std::vector<Var>& vars) {
+    Polynomial poly;
+    if (ok && !decodePolynomial(pos, end, poly, &vars)) ok = false;
+    return poly;
+  }
+};
+
+bool readCheckpoint(const std::string& path, CheckpointState& state, std::string& error,
+                    const CheckpointHeaderHook& header) {
+  FILE* file = fopen(path.c_str(), "rb");
+  if (!file) {
+    error = strerror(errno);
+    return false;
+  }
+  std::vector<uint8_t> bytes;
+  uint8_t block[1 << 16];
+  size_t n;
+  while ((n = fread(block, 1, sizeof block, file)) > 0) bytes.insert(bytes.end(), block, block + n);
+  const bool read_error = ferror(file);
+  fclose(file);
+  if (read_error) {
+    error = "read error";
+    return false;
+  }
+  if (bytes.size() < 9 || memcmp(bytes.data(), checkpoint_magic, 4)
+      || memcmp(bytes.data() + bytes.size() - 4, checkpoint_magic, 4)) {
+    error = "not a complete checkpoint";
+    return false;
+  }
+  if (bytes[4] != checkpoint_version) {
+    error = "unsupported checkpoint version";
+    return false;
+  }
+
+  CheckpointDecoder d{bytes.data() + 5, bytes.data() + bytes.size() - 4};
+  state.lineno = d.number();
+  state.offset = d.number();
+  state.binary = d.number();
+  state.boolean = d.number();
+  state.modulus = d.string();
+  if (!state.modulus.empty() && !setModulus(state.modulus)) {
+    error = "modulus " + state.modulus + " is not supported by this build";
+    return false;
+  }
+  // fingerprints of the polynomials depend on the settings made here
+  if (header) header(state);
+  // polynomials are built as they were, with Boolean variables or not
+  ArithmeticContext context = ArithmeticContext::current();
+  context.idempotent = state.boolean;
+  ArithmeticScope arithmetic(context);
+
+  std::vector<Var> vars(d.count());
+  for (Var& v : vars) v = internVariable(d.string());
+
+  state.allowed_variables.resize(d.count());
+  for (Var& v : state.allowed_variables) v = d.var(vars);
+  for (auto* assignments : {&state.substitution_stack, &state.current_substitution}) {
+    assignments->resize(d.count());
+    for (auto& [var, value] : *assignments) {
+      var = d.var(vars);
+      value = d.signedNumber();
+    }
+  }
+  state.declared_roots.resize(d.count());
+  for (auto& [var, roots] : state.declared_roots) {
+    var = d.var(vars);
+    roots.resize(d.count());
+    for (int& root : roots) root = d.signedNumber();
+  }
+  CheckpointCounters& c = state.counters;
+  for (uint64_t& rules : c.rules) rules = d.number();
+  for (double& seconds : c.rule_seconds) seconds = d.real();
+  c.unverified_rules = d.number();
+  c.fingerprint_rules = d.number();
+  c.probabilistic_rules = d.number();
+  c.worst_rule_log2 = d.real();
+  c.monomial_products = d.number();
+  c.eager_deletions = d.number();
+  state.last_conclusion_line = d.number();
+  if (d.number()) state.last_conclusion = storePolynomial(d.polynomial(vars));
+
+  state.polynomials.resize(d.count());
+  for (auto& [id, poly] : state.polynomials) {
+    id = d.signedNumber();
+    if (d.ok) poly = storePolynomial(d.polynomial(vars));
+  }
+  if (!d.ok || d.pos != d.end) {
+    error = "corrupted checkpoint";
+    return false;
+  }
+  return true;
+}
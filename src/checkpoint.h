@@ -0,0 +1,112 @@
+/*------------------------------------------------------------------------*/
+/*! \file checkpoint.h
+    \brief snapshots of the checking state for resuming a check
+
+  A checkpoint holds everything a checker needs to continue after a
+  rule: the polynomials bound to IDs, the variables allowed in
+  multipliers, the open branches and declared roots, the modulus, the
+  counters of the statistics and the position in the proof. Stored
+  polynomials are immutable, so taking a snapshot only copies their
+  handles, and the snapshot is encoded and written on a thread of its
+  own while the check goes on. Spilled polynomials are copied from the
+  spill file as they are.
+
+  The file starts with the magic bytes "PCKP" and a version byte, numbers
+  are varints and polynomials are encoded like in spill files, with
+  variables given by their index in the list of names at the start of
+  the file. A checkpoint is written to a temporary file which then
+  replaces the previous one, so a check killed while writing leaves the
+  last complete checkpoint behind.
+
+  Part of Pacheck 3.0 : PAC proof checker.
+*/
+/*------------------------------------------------------------------------*/
+#ifndef PACHECK2_SRC_CHECKPOINT_H_
+#define PACHECK2_SRC_CHECKPOINT_H_
+/*------------------------------------------------------------------------*/
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+#include "polynomial.hpp"
+#include "spill.h"
+#include "store.h"
+/*------------------------------------------------------------------------*/
+
+/// the counters of the statistics kept across a resumed check
+struct CheckpointCounters {
+  uint64_t rules[6] = {};        // processed, per Rule::Kind
+  double rule_seconds[6] = {};   // per Rule::Kind
+  uint64_t unverified_rules = 0;
+  uint64_t fingerprint_rules = 0;
+  uint64_t probabilistic_rules = 0;
+  double worst_rule_log2 = 0;
+  uint64_t monomial_products = 0;
+  uint64_t eager_deletions = 0;
+};
+
+struct CheckpointState {
+  int lineno = 0;           // of the last rule processed
+  uint64_t offset = 0;      // bytes of the proof up to the end of that rule
+  bool binary = false;      // the proof is binary, resumed by rule numbers
+  std::string modulus;      // decimal digits, empty before the 'm' rule
+  bool boolean = false;     // variables were Boolean
+  std::vector<std::pair<int, PolynomialRef>> polynomials;  // by ID, spilled ones when read
+  std::vector<std::pair<int, SpillSlot>> spilled;          // by ID, when written
+  std::vector<Var> allowed_variables;
+  std::vector<std::pair<Var, int>> substitution_stack;
+  std::vector<std::pair<Var, int>> current_substitution;
+  std::vector<std::pair<Var, std::vector<int>>> declared_roots;
+  PolynomialRef last_conclusion;  // with a target, may be null
+  int last_conclusion_line = 0;
+  CheckpointCounters counters;
+};
+
+/// writes checkpoints in the background, one at a time
+class CheckpointWriter {
+ public:
+  CheckpointWriter() {}
+  ~CheckpointWriter() { finish(); }
+  CheckpointWriter(const CheckpointWriter&) = delete;
+  CheckpointWriter& operator=(const CheckpointWriter&) = delete;
+
+  /// writes 'state' to 'path' on a thread of its own, which copies
+  /// spilled polynomials from 'spill', after the previous checkpoint
+  /// was written, returns false if writing that one failed, see error()
+  bool write(const std::string& path, CheckpointState state, const SpillFile& spill);
+
+  /// waits until the last checkpoint is written, returns false on failure
+  bool finish();
+
+  size_t checkpoints() const { return checkpoints_; }
+  size_t bytesWritten() const { return bytes_; }
+
+  /// non-empty if writing a checkpoint failed
+  const std::string& error() const { return error_; }
+
+ private:
+  void run(std::string path, CheckpointState state, const SpillFile* spill,
+           ArithmeticContext context);
+
+  std::thread thread_;
+  size_t checkpoints_ = 0;
+  size_t bytes_ = 0;
+  std::string error_;
+};
+
+/// called by readCheckpoint with the header of the state (the fields up
+/// to 'boolean') once the modulus is set and before any polynomial is
+/// built, e.g. to settle the fingerprint setting, may throw
+typedef std::function<void(const CheckpointState& state)> CheckpointHeaderHook;
+
+/// reads the checkpoint at 'path', interning its variables and setting
+/// the modulus of the calling thread, returns false with the reason in
+/// 'error' on failure
+bool readCheckpoint(const std::string& path, CheckpointState& state, std::string& error,
+                    const CheckpointHeaderHook& header = nullptr);
+
+/*------------------------------------------------------------------------*/
+#endif  // PACHECK2_SRC_CHECKPOINT_H_
@@ -0,0 +1,200 @@
+/*------------------------------------------------------------------------*/
+/*! \file coefficient.cpp
+    \brief coefficient arithmetic modulo the proof modulus
+
+  Part of Pacheck 3.0 : PAC proof checker.
+*/
+/*------------------------------------------------------------------------*/
+#include "coefficient.h"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+/*------------------------------------------------------------------------*/
+#ifdef PACHECK_GMP
+
+thread_local Modulus modulus = 0;
+
+bool setModulus(std::string_view digits) {
+  return modulus.set_str(std::string(digits), 10) == 0;
+}
+
+Coeff coeffFromInt(int64_t value) {
+  Coeff c = static_cast<long>(value);
+  if (modulus != 0) mpz_mod(c.get_mpz_t(), c.get_mpz_t(), modulus.get_mpz_t());
+  return c;
+}
+
+Coeff coeffFromDigits(std::string_view digits) {
+  Coeff c(std::string(digits), 10);
+  if (modulus != 0) mpz_mod(c.get_mpz_t(), c.get_mpz_t(), modulus.get_mpz_t());
+  return c;
+}
+
+Coeff powCoeff(Coeff base, uint32_t exp) {
+  Coeff r;
+  if (modulus != 0) {
+    mpz_powm_ui(r.get_mpz_t(), base.get_mpz_t(), exp, modulus.get_mpz_t());
+  } else {
+    mpz_pow_ui(r.get_mpz_t(), base.get_mpz_t(), exp);
+  }
+  return r;
+}
+
+std::string coeffToString(const Coeff& c) { return c.get_str(); }
+
+void coeffToBase128(const Coeff& c, std::vector<uint8_t>& digits) {
+  const size_t old_size = digits.size();
+  digits.resize(old_size + mpz_sizeinbase(c.get_mpz_t(), 2) / 7 + 1);
+  size_t count = 0;
+  // one nail bit leaves 7 value bits per byte
+  mpz_export(digits.data() + old_size, &count, -1, 1, 0, 1, c.get_mpz_t());
+  digits.resize(old_size + std::max<size_t>(count, 1));
+}
+
+Coeff coeffFromBase128(const uint8_t* digits, size_t size) {
+  Coeff c;
+  mpz_import(c.get_mpz_t(), size, -1, 1, 0, 1, digits);
+  if (modulus != 0) mpz_mod(c.get_mpz_t(), c.get_mpz_t(), modulus.get_mpz_t());
+  return c;
+}
+
+bool modulusIsPrime() {
+  return modulus > 1 && mpz_probab_prime_p(modulus.get_mpz_t(), 40) > 0;
+}
+
+double modulusLog2() {
+  if (modulus == 0) return std::numeric_limits<double>::infinity();
+  long exp;
+  double mantissa = mpz_get_d_2exp(&exp, modulus.get_mpz_t());
+  return std::log2(mantissa) + exp;
+}
+
+Coeff randomCoeff(std::mt19937_64& rng) {
+  // 64 extra random bits make the bias of the final reduction negligible
+  Coeff r = 0;
+  for (size_t bits = 0; bits < mpz_sizeinbase(modulus.get_mpz_t(), 2) + 64; bits += 64) {
+    r <<= 64;
+    r += static_cast<unsigned long>(rng());
+  }
+  mpz_mod(r.get_mpz_t(), r.get_mpz_t(), modulus.get_mpz_t());
+  return r;
+}
+
+#else
+/*------------------------------------------------------------------------*/
+
+// until an 'm' rule is read coefficients wrap around at 2^64
+constinit thread_local Modulus modulus = {0, ~0ull, true, 0};
+
+bool setModulus(std::string_view digits) {
+  const unsigned __int128 limit = static_cast<unsigned __int128>(1) << 64;
+  unsigned __int128 value = 0;
+  for (char ch : digits) {
+    value = value * 10 + (ch - '0');
+    if (value > limit) return false;
+  }
+  if (value == 0) return false;
+
+  if (value == limit) {
+    modulus = {0, ~0ull, true, 0};
+  } else if ((value & (value - 1)) == 0) {
+    uint64_t v = static_cast<uint64_t>(value);
+    modulus = {v, v - 1, true, 0};
+  } else {
+    uint64_t v = static_cast<uint64_t>(value);
+    modulus = {v, 0, false, ~static_cast<unsigned __int128>(0) / v};
+  }
+  return true;
+}
+
+Coeff coeffFromInt(int64_t value) {
+  uint64_t magnitude = value < 0 ? 0 - static_cast<uint64_t>(value) : value;
+  Coeff c = reduceCoeff(magnitude);
+  return value < 0 ? negCoeff(c) : c;
+}
+
+Coeff coeffFromDigits(std::string_view digits) {
+  // consume up to 19 digits at a time, which fit into 64 bits
+  Coeff c = 0;
+  size_t i = 0;
+  while (i < digits.size()) {
+    uint64_t chunk = 0, scale = 1;
+    for (int k = 0; k < 19 && i < digits.size(); ++k, ++i) {
+      chunk = chunk * 10 + (digits[i] - '0');
+      scale *= 10;
+    }
+    c = reduceCoeff(static_cast<unsigned __int128>(c) * scale + chunk);
+  }
+  return c;
+}
+
+Coeff powCoeff(Coeff base, uint32_t exp) {
+  Coeff r = reduceCoeff(1);
+  while (exp) {
+    if (exp & 1) r = mulCoeff(r, base);
+    base = mulCoeff(base, base);
+    exp >>= 1;
+  }
+  return r;
+}
+
+std::string coeffToString(const Coeff& c) { return std::to_string(c); }
+
+void coeffToBase128(const Coeff& c, std::vector<uint8_t>& digits) {
+  uint64_t x = c;
+  do {
+    digits.push_back(x & 127);
+    x >>= 7;
+  } while (x);
+}
+
+Coeff coeffFromBase128(const uint8_t* digits, size_t size) {
+  // Horner's rule from the most significant digit
+  Coeff c = 0;
+  for (size_t i = size; i-- > 0;) {
+    c = reduceCoeff((static_cast<unsigned __int128>(c) << 7) + digits[i]);
+  }
+  return c;
+}
+
+static uint64_t mulMod(uint64_t a, uint64_t b, uint64_t n) {
+  return static_cast<uint64_t>(static_cast<unsigned __int128>(a) * b % n);
+}
+
+bool modulusIsPrime() {
+  const uint64_t n = modulus.value;
+  if (modulus.power_of_two) return n == 2;
+  if (n % 2 == 0) return false;
+
+  // Miller-Rabin with these bases is exact for all 64-bit numbers
+  uint64_t d = n - 1;
+  int s = 0;
+  while (d % 2 == 0) d /= 2, ++s;
+  for (uint64_t a : {2, 3, 5, 7, 11, 13, 17, 19, 23, 29, 31, 37}) {
+    if (a % n == 0) continue;
+    uint64_t x = 1, base = a, e = d;
+    for (; e; e >>= 1, base = mulMod(base, base, n)) {
+      if (e & 1) x = mulMod(x, base, n);
+    }
+    if (x == 1 || x == n - 1) continue;
+    int i = 1;
+    for (; i < s; ++i) {
+      x = mulMod(x, x, n);
+      if (x == n - 1) break;
+    }
+    if (i == s) return false;
+  }
+  return true;
+}
+
+double modulusLog2() {
+  return modulus.value ? std::log2(static_cast<double>(modulus.value)) : 64;
+}
+
+Coeff randomCoeff(std::mt19937_64& rng) {
+  if (modulus.power_of_two) return rng() & modulus.mask;
+  return reduceCoeff((static_cast<unsigned __int128>(rng()) << 64) | rng());
+}
+
+#endif
@@ -0,0 +1,155 @@
+/*------------------------------------------------------------------------*/
+/*! \file coefficient.h
+    \brief coefficient arithmetic modulo the proof modulus
+
+  By default coefficients are 64-bit residues. Moduli up to 2^64 are
+  supported, products are formed in 128 bits and reduced with Barrett
+  reduction (powers of two are reduced by masking), so that arithmetic
+  never allocates. Configuring with '--gmp' defines PACHECK_GMP and
+  switches to arbitrary precision coefficients, which also supports
+  larger moduli and the unbounded modulus 'm 0'.
+
+  Coefficients are always kept reduced, i.e. in [0, modulus). The
+  modulus belongs to the calling thread, so that proofs with different
+  moduli can be checked side by side (see ArithmeticContext).
+
+  Part of Pacheck 3.0 : PAC proof checker.
+*/
+/*------------------------------------------------------------------------*/
+#ifndef PACHECK2_SRC_COEFFICIENT_H_
+#define PACHECK2_SRC_COEFFICIENT_H_
+/*------------------------------------------------------------------------*/
+#include <cstdint>
+#include <random>
+#include <string>
+#include <string_view>
+#include <vector>
+#ifdef PACHECK_GMP
+#include <gmpxx.h>
+#endif
+/*------------------------------------------------------------------------*/
+#ifdef PACHECK_GMP
+
+typedef mpz_class Coeff;
+typedef mpz_class Modulus;
+
+/// modulus of the proof, 0 if coefficients are unbounded integers
+extern thread_local Modulus modulus;
+
+inline Coeff addCoeff(const Coeff& a, const Coeff& b) {
+  Coeff r = a + b;
+  if (modulus != 0 && r >= modulus) r -= modulus;
+  return r;
+}
+
+inline Coeff negCoeff(const Coeff& a) {
+  if (modulus == 0) return -a;
+  return a == 0 ? a : Coeff(modulus - a);
+}
+
+inline Coeff mulCoeff(const Coeff& a, const Coeff& b) {
+  Coeff r = a * b;
+  if (modulus != 0) mpz_mod(r.get_mpz_t(), r.get_mpz_t(), modulus.get_mpz_t());
+  return r;
+}
+
+inline bool isNegativeCoeff(const Coeff& a) { return a < 0; }
+
+inline uint64_t hashCoeff(const Coeff& a) {
+  return mpz_get_ui(a.get_mpz_t()) ^ (static_cast<uint64_t>(mpz_size(a.get_mpz_t())) << 56);
+}
+
+#else
+
+typedef uint64_t Coeff;
+
+struct Modulus {
+  uint64_t value;             // the modulus, 0 encodes 2^64
+  uint64_t mask;              // value - 1 if it is a power of two
+  bool power_of_two;
+  unsigned __int128 barrett;  // floor((2^128 - 1) / value) otherwise
+};
+
+/// modulus of the proof, constant initialized so that no thread-local
+/// wrapper is called on access
+extern constinit thread_local Modulus modulus;
+
+/// reduces any 128-bit value, using at most two correction steps
+inline uint64_t reduceCoeff(unsigned __int128 x) {
+  if (modulus.power_of_two) return static_cast<uint64_t>(x) & modulus.mask;
+
+  // q = floor(x * barrett / 2^128) computed from 64-bit limbs
+  const uint64_t x0 = static_cast<uint64_t>(x), x1 = static_cast<uint64_t>(x >> 64);
+  const uint64_t u0 = static_cast<uint64_t>(modulus.barrett);
+  const uint64_t u1 = static_cast<uint64_t>(modulus.barrett >> 64);
+  const unsigned __int128 lo = static_cast<unsigned __int128>(x0) * u0;
+  const unsigned __int128 m1 = static_cast<unsigned __int128>(x1) * u0;
+  const unsigned __int128 m2 = static_cast<unsigned __int128>(x0) * u1;
+  const unsigned __int128 carry = (lo >> 64) + static_cast<uint64_t>(m1)
+                                  + static_cast<uint64_t>(m2);
+  const unsigned __int128 q = static_cast<unsigned __int128>(x1) * u1
+                              + (m1 >> 64) + (m2 >> 64) + (carry >> 64);
+
+  unsigned __int128 r = x - q * modulus.value;
+  while (r >= modulus.value) r -= modulus.value;
+  return static_cast<uint64_t>(r);
+}
+
+inline Coeff addCoeff(Coeff a, Coeff b) {
+  Coeff r = a + b;
+  if (modulus.power_of_two) return r & modulus.mask;
+  if (r < a || r >= modulus.value) r -= modulus.value;
+  return r;
+}
+
+inline Coeff negCoeff(Coeff a) {
+  if (modulus.power_of_two) return (0 - a) & modulus.mask;
+  return a == 0 ? 0 : modulus.value - a;
+}
+
+inline Coeff mulCoeff(Coeff a, Coeff b) {
+  if (modulus.power_of_two) return (a * b) & modulus.mask;
+  return reduceCoeff(static_cast<unsigned __int128>(a) * b);
+}
+
+inline bool isNegativeCoeff(Coeff) { return false; }
+
+inline uint64_t hashCoeff(Coeff a) { return a; }
+
+#endif
+/*------------------------------------------------------------------------*/
+// Functions
+
+/// sets the modulus given in decimal,
+/// returns false if this build cannot represent it
+bool setModulus(std::string_view digits);
+
+/// reduces a machine integer
+Coeff coeffFromInt(int64_t value);
+
+/// reduces an unsigned decimal literal of arbitrary length
+Coeff coeffFromDigits(std::string_view digits);
+
+/// computes base^exp by repeated squaring
+Coeff powCoeff(Coeff base, uint32_t exp);
+
+std::string coeffToString(const Coeff& c);
+
+/// appends the base-128 digits of |c|, least significant first and at
+/// least one, as used by binary proofs
+void coeffToBase128(const Coeff& c, std::vector<uint8_t>& digits);
+
+/// reduces a magnitude given by base-128 digits, least significant first
+Coeff coeffFromBase128(const uint8_t* digits, size_t size);
+
+/// whether the modulus is a prime, i.e. coefficients form a field
+bool modulusIsPrime();
+
+/// log2 of the modulus (of 2^64 before an 'm' rule, infinity if unbounded)
+double modulusLog2();
+
+/// draws a uniformly distributed residue, requires a bounded modulus
+Coeff randomCoeff(std::mt19937_64& rng);
+
+/*------------------------------------------------------------------------*/
+#endif  // PACHECK2_SRC_COEFFICIENT_H_
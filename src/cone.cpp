@@ -0,0 +1,69 @@
+/*------------------------------------------------------------------------*/
+/*! \file cone.cpp
+    \brief the rules the conclusion of a proof depends on
+
+  Part of Pacheck 3.0 : PAC proof checker.
+*/
+/*------------------------------------------------------------------------*/
+#include "cone.h"
+/*------------------------------------------------------------------------*/
+
+void ProofCone::grow(int lineno) {
+  needed_.resize(lineno + 1);
+  lincomb_.resize(lineno + 1);
+  first_antecedent_.resize(lineno + 2, antecedents_.size());
+}
+
+void ProofCone::markDefinition(int id) {
+  auto it = definitions_.find(id);
+  if (it != definitions_.end()) needed_[it->second] = true;
+}
+
+void ProofCone::record(const RuleIds& ids, int lineno) {
+  if (lineno < 0) return;
+  grow(lineno);
+  switch (ids.kind) {
+    case Rule::Mod:
+      break;
+    case Rule::Axiom:
+      definitions_[ids.id] = lineno;
+      break;
+    case Rule::Delete:
+      definitions_.erase(ids.id);
+      break;
+    case Rule::LinComb:
+      // unknown antecedents are left to the check
+      for (int id : ids.antecedents) {
+        auto it = definitions_.find(id);
+        if (it != definitions_.end()) antecedents_.push_back(it->second);
+      }
+      first_antecedent_[lineno + 1] = antecedents_.size();
+      definitions_[ids.id] = lineno;
+      lincomb_[lineno] = true;
+      last_lincomb_ = lineno;
+      lincombs_++;
+      if (branched_) needed_[lineno] = true;
+      break;
+    case Rule::Root:
+      markDefinition(ids.id);
+      break;
+    case Rule::Branch:
+      branched_ = true;
+      break;
+  }
+}
+
+void ProofCone::close() {
+  if (last_lincomb_) needed_[last_lincomb_] = true;
+  definitions_.clear();
+  // antecedents precede their rule, so one backward sweep suffices
+  for (size_t line = needed_.size(); line-- > 0;) {
+    if (!needed_[line] || !lincomb_[line]) continue;
+    cone_lincombs_++;
+    for (uint32_t i = first_antecedent_[line]; i < first_antecedent_[line + 1]; ++i) {
+      needed_[antecedents_[i]] = true;
+    }
+  }
+  antecedents_ = std::vector<int>();
+  first_antecedent_ = std::vector<uint32_t>();
+}
@@ -0,0 +1,60 @@
+/*------------------------------------------------------------------------*/
+/*! \file cone.h
+    \brief the rules the conclusion of a proof depends on
+
+  With '--backward' a pre-pass over the proof records which earlier line
+  defines each antecedent of a rule, using the IDs alone (see
+  scanRuleIds), and marks the cone of the conclusion backwards from its
+  roots: the last '%' rule of the proof, which concludes the target or 1,
+  and the polynomials of 'r' rules. Which rules close a branch by deriving
+  1 is only known from the arithmetic, so from the first 'b' rule on all
+  '%' rules are roots. The check then binds the claimed conclusions of the
+  other '%' rules without verifying them.
+
+  Part of Pacheck 3.0 : PAC proof checker.
+*/
+/*------------------------------------------------------------------------*/
+#ifndef PACHECK2_SRC_CONE_H_
+#define PACHECK2_SRC_CONE_H_
+/*------------------------------------------------------------------------*/
+#include <cstddef>
+#include <cstdint>
+#include <unordered_map>
+#include <vector>
+#include "parser.h"
+/*------------------------------------------------------------------------*/
+
+class ProofCone {
+ public:
+  /// records the rule of line 'lineno', lines are recorded in order
+  void record(const RuleIds& ids, int lineno);
+
+  /// marks the cone after the last rule was recorded
+  void close();
+
+  /// whether the '%' rule of line 'lineno' has to be verified
+  bool needed(int lineno) const {
+    return lineno < 0 || size_t(lineno) >= needed_.size() || needed_[lineno];
+  }
+
+  /// '%' rules outside the cone
+  size_t trimmed() const { return lincombs_ - cone_lincombs_; }
+
+ private:
+  /// marks the line defining 'id', if known
+  void markDefinition(int id);
+  void grow(int lineno);
+
+  std::unordered_map<int, int> definitions_;  // line of the rule defining each ID
+  std::vector<bool> needed_;                  // indexed by line
+  std::vector<bool> lincomb_;                 // whether a line is a '%' rule
+  std::vector<uint32_t> first_antecedent_;    // of each line in 'antecedents_'
+  std::vector<int> antecedents_;              // lines defining the antecedents
+  int last_lincomb_ = 0;
+  bool branched_ = false;                     // a 'b' rule was recorded
+  size_t lincombs_ = 0;
+  size_t cone_lincombs_ = 0;
+};
+
+/*------------------------------------------------------------------------*/
+#endif  // PACHECK2_SRC_CONE_H_
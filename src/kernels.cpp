@@ -0,0 +1,166 @@
+/*------------------------------------------------------------------------*/
+/*! \file kernels.cpp
+    \brief vectorized kernels over the factors of monomials
+
+  Part of Pacheck 3.0 : PAC proof checker.
+*/
+/*------------------------------------------------------------------------*/
+#include "kernels.h"
+
+#include <cstring>
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define PACHECK_X86
+#endif
+/*------------------------------------------------------------------------*/
+static const uint32_t var_mul = factor_var_mul;
+static const uint32_t exp_mul = factor_exp_mul;
+static const uint32_t index_mul = factor_index_mul;
+static const uint32_t mix_mul = factor_mix_mul;
+
+static uint64_t word(const VarPower& f) { return (uint64_t(f.var) << 32) | f.exp; }
+/*------------------------------------------------------------------------*/
+// Scalar, also inlined for monomials of few factors
+
+static const FactorKernels scalar_kernels = {"scalar", mismatchFactorsScalar,
+                                             summarizeFactorsScalar};
+/*------------------------------------------------------------------------*/
+#ifdef PACHECK_X86
+// SSE4.1, two factors per vector
+
+/// the results of the kernels are in the even lanes 0 and 2
+__attribute__((target("sse4.1"))) static uint32_t addEvenLanes(__m128i v) {
+  return uint32_t(_mm_cvtsi128_si32(v)) + uint32_t(_mm_extract_epi32(v, 2));
+}
+
+__attribute__((target("sse4.1"))) static uint32_t xorEvenLanes(__m128i v) {
+  return uint32_t(_mm_cvtsi128_si32(v)) ^ uint32_t(_mm_extract_epi32(v, 2));
+}
+
+__attribute__((target("sse4.1"))) static uint32_t mismatchSse4(const VarPower* a,
+                                                               const VarPower* b, uint32_t n) {
+  uint32_t i = 0;
+  for (; i + 2 <= n; i += 2) {
+    const __m128i va = _mm_loadu_si128(reinterpret_cast<const __m128i*>(a + i));
+    const __m128i vb = _mm_loadu_si128(reinterpret_cast<const __m128i*>(b + i));
+    const int equal = _mm_movemask_pd(_mm_castsi128_pd(_mm_cmpeq_epi64(va, vb)));
+    if (equal != 3) return i + (equal & 1);
+  }
+  if (i < n && word(a[i]) == word(b[i])) ++i;
+  return i;
+}
+
+__attribute__((target("sse4.1"))) static void summarizeSse4(const VarPower* f, uint32_t n,
+                                                            uint32_t& degree, uint64_t& hash) {
+  const __m128i muls = _mm_setr_epi32(var_mul, exp_mul, var_mul, exp_mul);
+  const __m128i mix = _mm_set1_epi32(mix_mul);
+  const __m128i even = _mm_setr_epi32(-1, 0, -1, 0);
+  __m128i index = _mm_setr_epi32(0, 0, index_mul, 0);
+  const __m128i step = _mm_setr_epi32(2 * index_mul, 0, 2 * index_mul, 0);
+  __m128i sum = _mm_setzero_si128(), x = sum, deg = sum;
+  for (uint32_t i = 0; i < n; i += 2) {
+    __m128i v, valid = even;
+    if (i + 2 <= n) {
+      v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(f + i));
+    } else {
+      v = _mm_loadl_epi64(reinterpret_cast<const __m128i*>(f + i));
+      valid = _mm_setr_epi32(-1, 0, 0, 0);
+    }
+    const __m128i m = _mm_mullo_epi32(v, muls);
+    __m128i t = _mm_xor_si128(_mm_xor_si128(m, _mm_srli_epi64(m, 32)), index);
+    t = _mm_and_si128(_mm_mullo_epi32(t, mix), valid);
+    sum = _mm_add_epi32(sum, t);
+    x = _mm_xor_si128(x, t);
+    deg = _mm_add_epi32(deg, _mm_srli_epi64(v, 32));
+    index = _mm_add_epi32(index, step);
+  }
+  degree = addEvenLanes(deg);
+  hash = finishFactorHash(addEvenLanes(sum), xorEvenLanes(x));
+}
+
+static const FactorKernels sse4_kernels = {"sse4", mismatchSse4, summarizeSse4};
+/*------------------------------------------------------------------------*/
+// AVX2, four factors per vector
+
+/// masks the first 'n' < 4 factors of a vector
+__attribute__((target("avx2"))) static __m256i tailMask(uint32_t n) {
+  return _mm256_cmpgt_epi64(_mm256_set1_epi64x(n), _mm256_setr_epi64x(0, 1, 2, 3));
+}
+
+__attribute__((target("avx2"))) static uint32_t mismatchAvx2(const VarPower* a,
+                                                             const VarPower* b, uint32_t n) {
+  uint32_t i = 0;
+  for (; i + 4 <= n; i += 4) {
+    const __m256i va = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(a + i));
+    const __m256i vb = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(b + i));
+    const int equal = _mm256_movemask_pd(_mm256_castsi256_pd(_mm256_cmpeq_epi64(va, vb)));
+    if (equal != 15) return i + __builtin_ctz(~equal);
+  }
+  if (i == n) return n;
+  // masked lanes load as zero in both
+  const __m256i mask = tailMask(n - i);
+  const __m256i va = _mm256_maskload_epi64(reinterpret_cast<const long long*>(a + i), mask);
+  const __m256i vb = _mm256_maskload_epi64(reinterpret_cast<const long long*>(b + i), mask);
+  const int equal = _mm256_movemask_pd(_mm256_castsi256_pd(_mm256_cmpeq_epi64(va, vb)));
+  return equal == 15 ? n : i + __builtin_ctz(~equal);
+}
+
+__attribute__((target("avx2"))) static void summarizeAvx2(const VarPower* f, uint32_t n,
+                                                          uint32_t& degree, uint64_t& hash) {
+  const __m256i muls = _mm256_setr_epi32(var_mul, exp_mul, var_mul, exp_mul, var_mul, exp_mul,
+                                         var_mul, exp_mul);
+  const __m256i mix = _mm256_set1_epi32(mix_mul);
+  const __m256i even = _mm256_setr_epi32(-1, 0, -1, 0, -1, 0, -1, 0);
+  __m256i index = _mm256_setr_epi32(0, 0, index_mul, 0, 2 * index_mul, 0, 3 * index_mul, 0);
+  const __m256i step = _mm256_setr_epi32(4 * index_mul, 0, 4 * index_mul, 0, 4 * index_mul, 0,
+                                         4 * index_mul, 0);
+  __m256i sum = _mm256_setzero_si256(), x = sum, deg = sum;
+  for (uint32_t i = 0; i < n; i += 4) {
+    __m256i v, valid = even;
+    if (i + 4 <= n) {
+      v = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(f + i));
+    } else {
+      const __m256i mask = tailMask(n - i);
+      v = _mm256_maskload_epi64(reinterpret_cast<const long long*>(f + i), mask);
+      valid = _mm256_and_si256(valid, mask);
+    }
+    const __m256i m = _mm256_mullo_epi32(v, muls);
+    __m256i t = _mm256_xor_si256(_mm256_xor_si256(m, _mm256_srli_epi64(m, 32)), index);
+    t = _mm256_and_si256(_mm256_mullo_epi32(t, mix), valid);
+    sum = _mm256_add_epi32(sum, t);
+    x = _mm256_xor_si256(x, t);
+    deg = _mm256_add_epi32(deg, _mm256_srli_epi64(v, 32));
+    index = _mm256_add_epi32(index, step);
+  }
+  const __m128i low = _mm256_castsi256_si128(deg), high = _mm256_extracti128_si256(deg, 1);
+  degree = addEvenLanes(_mm_add_epi32(low, high));
+  hash = finishFactorHash(
+      addEvenLanes(_mm_add_epi32(_mm256_castsi256_si128(sum), _mm256_extracti128_si256(sum, 1))),
+      xorEvenLanes(_mm_xor_si128(_mm256_castsi256_si128(x), _mm256_extracti128_si256(x, 1))));
+}
+
+static const FactorKernels avx2_kernels = {"avx2", mismatchAvx2, summarizeAvx2};
+#endif
+/*------------------------------------------------------------------------*/
+
+static const FactorKernels* bestKernels() {
+#ifdef PACHECK_X86
+  __builtin_cpu_init();
+  if (__builtin_cpu_supports("avx2")) return &avx2_kernels;
+  if (__builtin_cpu_supports("sse4.1")) return &sse4_kernels;
+#endif
+  return &scalar_kernels;
+}
+
+const FactorKernels* factor_kernels = bestKernels();
+
+bool selectFactorKernels(const char* name) {
+  const FactorKernels* kernels = nullptr;
+  if (!strcmp(name, "scalar")) kernels = &scalar_kernels;
+#ifdef PACHECK_X86
+  else if (!strcmp(name, "sse4") && __builtin_cpu_supports("sse4.1")) kernels = &sse4_kernels;
+  else if (!strcmp(name, "avx2") && __builtin_cpu_supports("avx2")) kernels = &avx2_kernels;
+#endif
+  if (kernels) factor_kernels = kernels;
+  return kernels;
+}
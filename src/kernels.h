@@ -0,0 +1,94 @@
+/*------------------------------------------------------------------------*/
+/*! \file kernels.h
+    \brief vectorized kernels over the factors of monomials
+
+  The (variable, exponent) pairs of a monomial form an array of 64-bit
+  words, which the kernels process four (AVX2) or two (SSE4.1) at a time
+  with a scalar fallback. The version is picked at startup by the
+  features of the CPU and can be overridden, e.g. for benchmarks. All
+  versions compute identical results, hashes included, so they can be
+  switched before any monomial is built. Monomials of the usual low
+  degree are handled by inlined scalar code, since calling a kernel
+  costs more than it saves on a few factors.
+
+  Part of Pacheck 3.0 : PAC proof checker.
+*/
+/*------------------------------------------------------------------------*/
+#ifndef PACHECK2_SRC_KERNELS_H_
+#define PACHECK2_SRC_KERNELS_H_
+/*------------------------------------------------------------------------*/
+#include <cstdint>
+#include "monomial.h"
+/*------------------------------------------------------------------------*/
+
+struct FactorKernels {
+  const char* name;
+  /// index of the first of 'n' factors in which 'a' and 'b' differ, 'n'
+  /// if they are equal
+  uint32_t (*mismatch)(const VarPower* a, const VarPower* b, uint32_t n);
+  /// total degree and hash of 'n' factors
+  void (*summarize)(const VarPower* factors, uint32_t n, uint32_t& degree, uint64_t& hash);
+};
+
+/// the kernels in use
+extern const FactorKernels* factor_kernels;
+
+/// below this many factors the scalar code inlined at the call is faster
+/// than calling a vector kernel
+const uint32_t min_vector_factors = 8;
+
+/// 32-bit mixing constants of the hash, see summarizeFactors
+const uint32_t factor_var_mul = 0x9E3779B1u;
+const uint32_t factor_exp_mul = 0x85EBCA77u;
+const uint32_t factor_index_mul = 0xC2B2AE3Du;
+const uint32_t factor_mix_mul = 0x27D4EB2Fu;
+
+inline uint64_t finishFactorHash(uint32_t sum, uint32_t x) {
+  uint64_t h = (uint64_t(sum) << 32) | x;
+  h ^= h >> 33;
+  h *= 0xFF51AFD7ED558CCDull;
+  h ^= h >> 33;
+  h *= 0xC4CEB9FE1A85EC53ull;
+  return h ^ (h >> 33);
+}
+
+/// selects the kernels "scalar", "sse4" or "avx2", returns false if the
+/// CPU does not support them
+bool selectFactorKernels(const char* name);
+
+inline uint32_t mismatchFactorsScalar(const VarPower* a, const VarPower* b, uint32_t n) {
+  uint32_t i = 0;
+  while (i < n && a[i].var == b[i].var && a[i].exp == b[i].exp) ++i;
+  return i;
+}
+
+/// every factor i contributes t_i = ((var * var_mul) ^ (exp * exp_mul) ^
+/// (i * index_mul)) * mix_mul in 32-bit arithmetic and the hash mixes the
+/// sum and the exclusive or of all t_i, which vector lanes compute
+/// independently
+inline void summarizeFactorsScalar(const VarPower* f, uint32_t n, uint32_t& degree,
+                                   uint64_t& hash) {
+  uint32_t deg = 0, sum = 0, x = 0;
+  for (uint32_t i = 0; i < n; ++i) {
+    const uint32_t t = ((f[i].var * factor_var_mul) ^ (f[i].exp * factor_exp_mul)
+                        ^ (i * factor_index_mul)) * factor_mix_mul;
+    sum += t;
+    x ^= t;
+    deg += f[i].exp;
+  }
+  degree = deg;
+  hash = finishFactorHash(sum, x);
+}
+
+inline uint32_t mismatchFactors(const VarPower* a, const VarPower* b, uint32_t n) {
+  if (n >= min_vector_factors) return factor_kernels->mismatch(a, b, n);
+  return mismatchFactorsScalar(a, b, n);
+}
+
+inline void summarizeFactors(const VarPower* f, uint32_t n, uint32_t& degree, uint64_t& hash) {
+  if (n >= min_vector_factors) return factor_kernels->summarize(f, n, degree, hash);
+  summarizeFactorsScalar(f, n, degree, hash);
+}
+
+/*------------------------------------------------------------------------*/
+#endif  // PACHECK2_SRC_KERNELS_H_
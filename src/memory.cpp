@@ -0,0 +1,163 @@
+/*------------------------------------------------------------------------*/
+/*! \file memory.cpp
+    \brief scratch arenas and allocation statistics
+
+  Part of Pacheck 3.0 : PAC proof checker.
+*/
+/*------------------------------------------------------------------------*/
+#include "memory.h"
+
+#include <atomic>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+#include <new>
+/*------------------------------------------------------------------------*/
+static const size_t chunk_size = 1 << 20;
+static const size_t max_chunks = 16;  // until the reset, then the heap is used
+/*------------------------------------------------------------------------*/
+// Allocation statistics
+
+struct PhaseCounters {
+  std::atomic<uint64_t> heap_allocations{0};
+  std::atomic<uint64_t> heap_bytes{0};
+  std::atomic<uint64_t> arena_allocations{0};
+  std::atomic<uint64_t> arena_bytes{0};
+};
+
+static PhaseCounters phase_counters[num_phases];
+static thread_local Phase current_phase = Phase::Other;
+
+const char* phaseName(Phase phase) {
+  switch (phase) {
+    case Phase::Parse: return "parse";
+    case Phase::Check: return "check";
+    case Phase::Store: return "store";
+    default: return "other";
+  }
+}
+
+AllocationCounts allocationCounts(Phase phase) {
+  const PhaseCounters& c = phase_counters[static_cast<int>(phase)];
+  return {c.heap_allocations, c.heap_bytes, c.arena_allocations, c.arena_bytes};
+}
+
+PhaseScope::PhaseScope(Phase phase) : saved_(current_phase) { current_phase = phase; }
+
+PhaseScope::~PhaseScope() { current_phase = saved_; }
+
+static void countHeapAllocation(size_t bytes) {
+  PhaseCounters& c = phase_counters[static_cast<int>(current_phase)];
+  c.heap_allocations.fetch_add(1, std::memory_order_relaxed);
+  c.heap_bytes.fetch_add(bytes, std::memory_order_relaxed);
+}
+
+void Arena::countAllocation(size_t bytes) {
+  PhaseCounters& c = phase_counters[static_cast<int>(current_phase)];
+  c.arena_allocations.fetch_add(1, std::memory_order_relaxed);
+  c.arena_bytes.fetch_add(bytes, std::memory_order_relaxed);
+}
+
+// every heap allocation of the program goes through these
+void* operator new(size_t bytes) {
+  countHeapAllocation(bytes);
+  if (void* p = malloc(bytes ? bytes : 1)) return p;
+  throw std::bad_alloc();
+}
+
+void* operator new[](size_t bytes) { return operator new(bytes); }
+void operator delete(void* p) noexcept { free(p); }
+void operator delete[](void* p) noexcept { free(p); }
+void operator delete(void* p, size_t) noexcept { free(p); }
+void operator delete[](void* p, size_t) noexcept { free(p); }
+/*------------------------------------------------------------------------*/
+// Arenas
+
+Arena::~Arena() {
+  for (char* chunk : chunks_) free(chunk);
+  for (char* block : large_) free(block);
+}
+
+void* Arena::refill(size_t bytes) {
+  if (bytes > chunk_size / 4) {
+    char* block = static_cast<char*>(malloc(bytes));
+    if (!block) throw std::bad_alloc();
+    large_.push_back(block);
+    countAllocation(bytes);
+    return block;
+  }
+  if (next_chunk_ == chunks_.size()) {
+    char* chunk = static_cast<char*>(malloc(chunk_size));
+    if (!chunk) throw std::bad_alloc();
+    chunks_.push_back(chunk);
+  }
+  pos_ = chunks_[next_chunk_++];
+  end_ = pos_ + chunk_size;
+  return allocate(bytes);
+}
+
+void Arena::reset() {
+#ifndef NDEBUG
+  // make use after release visible
+  for (size_t i = 0; i < next_chunk_; ++i) memset(chunks_[i], 0xdd, chunk_size);
+#endif
+  for (char* block : large_) free(block);
+  large_.clear();
+  next_chunk_ = 0;
+  pos_ = end_ = nullptr;
+}
+
+/// arenas of the nested scopes of a thread, reused by later scopes
+struct ArenaStack {
+  std::vector<std::unique_ptr<Arena>> arenas;
+  size_t depth = 0;
+  Arena* current = nullptr;  // null within a HeapScope
+};
+
+static thread_local ArenaStack arena_stack;
+
+bool Arena::exhausted() const { return next_chunk_ >= max_chunks; }
+
+Arena* currentArena() {
+  // dead temporaries are only reclaimed on a reset, so huge rules fall
+  // back to the heap once the arena is used up
+  Arena* arena = arena_stack.current;
+  return arena && !arena->exhausted() ? arena : nullptr;
+}
+
+ArenaScope::ArenaScope() : saved_(arena_stack.current) {
+  ArenaStack& s = arena_stack;
+  if (s.depth == s.arenas.size()) s.arenas.emplace_back(new Arena);
+  s.current = s.arenas[s.depth++].get();
+}
+
+ArenaScope::ArenaScope(Arena& arena) : saved_(arena_stack.current), owned_(false) {
+  arena_stack.current = &arena;
+}
+
+ArenaScope::~ArenaScope() {
+  ArenaStack& s = arena_stack;
+  if (owned_) s.arenas[--s.depth]->reset();
+  s.current = saved_;
+}
+
+static const size_t scratch_header = 8;  // keeps the 8-byte alignment of arenas
+
+void* scratchAllocate(size_t bytes) {
+  // large blocks, i.e. mostly growing vectors, are freed right away,
+  // otherwise every intermediate size would be kept until the reset
+  Arena* arena = bytes < chunk_size / 16 ? currentArena() : nullptr;
+  void* mem = arena ? arena->allocate(bytes + scratch_header)
+                    : ::operator new(bytes + scratch_header);
+  *static_cast<uint64_t*>(mem) = arena != nullptr;
+  return static_cast<char*>(mem) + scratch_header;
+}
+
+void scratchDeallocate(void* p) {
+  char* mem = static_cast<char*>(p) - scratch_header;
+  if (!*reinterpret_cast<uint64_t*>(mem)) ::operator delete(mem);
+}
+
+HeapScope::HeapScope() : saved_(arena_stack.current) { arena_stack.current = nullptr; }
+
+HeapScope::~HeapScope() { arena_stack.current = saved_; }
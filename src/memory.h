@@ -0,0 +1,148 @@
+/*------------------------------------------------------------------------*/
+/*! \file memory.h
+    \brief scratch arenas and allocation statistics
+
+  Temporaries of a rule, i.e. the terms and monomials of parsed,
+  multiplied and substituted polynomials, are bump allocated from a
+  scratch arena of the current thread, which is released in bulk when
+  the rule is done. Anything outliving the rule has to be moved to the
+  heap before, see Polynomial::makePersistent.
+
+  All allocations are counted per checking phase.
+
+  Part of Pacheck 3.0 : PAC proof checker.
+*/
+/*------------------------------------------------------------------------*/
+#ifndef PACHECK2_SRC_MEMORY_H_
+#define PACHECK2_SRC_MEMORY_H_
+/*------------------------------------------------------------------------*/
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+/*------------------------------------------------------------------------*/
+
+enum class Phase { Other, Parse, Check, Store };
+const int num_phases = 4;
+
+const char* phaseName(Phase phase);
+
+/// bump allocator over reusable chunks
+class Arena {
+ public:
+  Arena() = default;
+  Arena(const Arena&) = delete;
+  Arena& operator=(const Arena&) = delete;
+  ~Arena();
+
+  /// returns 8-byte aligned memory valid until the next reset
+  void* allocate(size_t bytes) {
+    bytes = (bytes + 7) & ~size_t(7);
+    if (bytes > size_t(end_ - pos_)) return refill(bytes);
+    void* p = pos_;
+    pos_ += bytes;
+    countAllocation(bytes);
+    return p;
+  }
+
+  /// releases all allocations at once
+  void reset();
+
+  /// whether the chunk budget until the next reset is used up
+  bool exhausted() const;
+
+  /// number of chunks in use since the last reset
+  size_t chunksUsed() const { return next_chunk_; }
+
+ private:
+  void* refill(size_t bytes);
+  static void countAllocation(size_t bytes);
+
+  std::vector<char*> chunks_;
+  std::vector<char*> large_;  // oversized allocations, freed on reset
+  size_t next_chunk_ = 0;
+  char* pos_ = nullptr;
+  char* end_ = nullptr;
+};
+
+/// the scratch arena of the current thread, null if temporaries have to
+/// be allocated on the heap, i.e. within a HeapScope or if it is exhausted
+Arena* currentArena();
+
+/// gives the current thread a fresh scratch arena, released at the end of
+/// the scope, scopes nest
+class ArenaScope {
+ public:
+  ArenaScope();
+  /// allocates from 'arena' within the scope, which is not reset at its
+  /// end, e.g. for rules handed to another thread
+  explicit ArenaScope(Arena& arena);
+  ArenaScope(const ArenaScope&) = delete;
+  ArenaScope& operator=(const ArenaScope&) = delete;
+  ~ArenaScope();
+
+ private:
+  Arena* saved_;
+  bool owned_ = true;  // taken from the stack of the thread
+};
+
+/// allocates on the heap within the scope, for results handed to other
+/// threads
+class HeapScope {
+ public:
+  HeapScope();
+  HeapScope(const HeapScope&) = delete;
+  HeapScope& operator=(const HeapScope&) = delete;
+  ~HeapScope();
+
+ private:
+  Arena* saved_;
+};
+
+/// attributes allocations of the current thread to 'phase'
+class PhaseScope {
+ public:
+  explicit PhaseScope(Phase phase);
+  PhaseScope(const PhaseScope&) = delete;
+  PhaseScope& operator=(const PhaseScope&) = delete;
+  ~PhaseScope();
+
+ private:
+  Phase saved_;
+};
+
+struct AllocationCounts {
+  uint64_t heap_allocations;
+  uint64_t heap_bytes;
+  uint64_t arena_allocations;
+  uint64_t arena_bytes;
+};
+
+AllocationCounts allocationCounts(Phase phase);
+/*------------------------------------------------------------------------*/
+
+/// allocates 8-byte aligned memory from the current scratch arena, or
+/// from the heap if there is none, a header records which one it was
+void* scratchAllocate(size_t bytes);
+void scratchDeallocate(void* p);
+
+/// stateless, so containers can be moved and swapped between scopes
+template <class T>
+struct ScratchAllocator {
+  static_assert(alignof(T) <= 8, "scratch memory is 8-byte aligned");
+  typedef T value_type;
+
+  ScratchAllocator() = default;
+  template <class U>
+  ScratchAllocator(const ScratchAllocator<U>&) {}
+
+  T* allocate(size_t n) { return static_cast<T*>(scratchAllocate(n * sizeof(T))); }
+  void deallocate(T* p, size_t) { scratchDeallocate(p); }
+
+  friend bool operator==(const ScratchAllocator&, const ScratchAllocator&) { return true; }
+};
+
+template <class T>
+using ScratchVector = std::vector<T, ScratchAllocator<T>>;
+
+/*------------------------------------------------------------------------*/
+#endif  // PACHECK2_SRC_MEMORY_H_
@@ -0,0 +1,301 @@
+/*------------------------------------------------------------------------*/
+/*! \file monomial.cpp
+    \brief variable interning table and packed monomials
+
+  Part of Pacheck 3.0 : PAC proof checker.
+*/
+/*------------------------------------------------------------------------*/
+#include "monomial.h"
+#include "kernels.h"
+#include "memory.h"
+
+#include <cstring>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <new>
+#include <unordered_map>
+#include <vector>
+/*------------------------------------------------------------------------*/
+// Variable table
+
+struct StringHash {
+  using is_transparent = void;
+  size_t operator()(std::string_view s) const {
+    return std::hash<std::string_view>{}(s);
+  }
+};
+
+// names never move once added, since the checking thread may print them
+// while the parsing thread interns further variables
+static std::mutex variable_mutex;
+static std::deque<std::string> variable_names;
+static std::unordered_map<std::string_view, Var, StringHash, std::equal_to<>> variable_index;
+static std::atomic<size_t> num_variables{0};
+
+Var internVariable(std::string_view name) {
+  std::lock_guard<std::mutex> lock(variable_mutex);
+  auto it = variable_index.find(name);
+  if (it != variable_index.end()) return it->second;
+
+  Var v = static_cast<Var>(variable_names.size());
+  variable_names.emplace_back(name);
+  variable_index.emplace(variable_names.back(), v);
+  num_variables.store(variable_names.size(), std::memory_order_release);
+  return v;
+}
+
+int64_t findVariable(std::string_view name) {
+  std::lock_guard<std::mutex> lock(variable_mutex);
+  auto it = variable_index.find(name);
+  return it == variable_index.end() ? -1 : it->second;
+}
+
+const std::string& variableName(Var v) {
+  std::lock_guard<std::mutex> lock(variable_mutex);
+  return variable_names[v];
+}
+
+size_t numVariables() { return num_variables.load(std::memory_order_acquire); }
+
+static thread_local bool idempotent = false;
+
+void setIdempotentVariables(bool enabled) { idempotent = enabled; }
+
+bool idempotentVariables() { return idempotent; }
+/*------------------------------------------------------------------------*/
+// Monomials
+
+Monomial::Data* Monomial::allocate(uint32_t size, bool heap) {
+  const size_t bytes = sizeof(Data) + size * sizeof(VarPower);
+  Arena* arena = heap ? nullptr : currentArena();
+  void* mem = arena ? arena->allocate(bytes) : ::operator new(bytes);
+  Data* d = new (mem) Data;
+  d->refs.store(1, std::memory_order_relaxed);
+  d->size = size;
+  d->interned = 0;
+  d->in_arena = arena != nullptr;
+  return d;
+}
+
+/// computes degree and hash once the factors have been filled in
+void Monomial::finalize() {
+  summarizeFactors(data_->factors(), data_->size, data_->degree, data_->hash);
+}
+
+void Monomial::release() {
+  if (data_ && data_->refs.fetch_sub(1, std::memory_order_acq_rel) == 1) destroy(data_);
+  data_ = nullptr;
+}
+
+Monomial::Monomial(Var var, uint32_t exp) : data_(nullptr) {
+  if (exp == 0) return;
+  data_ = allocate(1);
+  data_->factors()[0] = {var, idempotent ? 1u : exp};
+  finalize();
+}
+
+Monomial::Monomial(const VarPower* factors, uint32_t size) : data_(nullptr) {
+  if (size == 0) return;
+  data_ = allocate(size);
+  memcpy(data_->factors(), factors, size * sizeof(VarPower));
+  if (idempotent) {
+    for (uint32_t i = 0; i < size; ++i) data_->factors()[i].exp = 1;
+  }
+  finalize();
+}
+
+Monomial& Monomial::operator=(const Monomial& other) {
+  other.retain();
+  release();
+  data_ = other.data_;
+  return *this;
+}
+
+Monomial& Monomial::operator=(Monomial&& other) noexcept {
+  if (this != &other) {
+    release();
+    data_ = other.data_;
+    other.data_ = nullptr;
+  }
+  return *this;
+}
+
+uint32_t Monomial::exponent(Var var) const {
+  for (const VarPower& f : *this) {
+    if (f.var == var) return f.exp;
+    if (f.var > var) break;
+  }
+  return 0;
+}
+/*------------------------------------------------------------------------*/
+// Interning
+
+/// open addressing table of interned blocks, holding no references
+struct MonomialTable {
+  typedef Monomial::Data Data;
+
+  std::mutex mutex;
+  std::vector<Data*> slots;  // power of two size, at most half used
+  size_t used = 0;           // live blocks and tombstones
+  size_t live = 0;
+  size_t peak = 0;           // of 'live'
+
+  static Data* tombstone() { return reinterpret_cast<Data*>(uintptr_t(1)); }
+
+  static bool equal(const Data* a, const Data* b) {
+    return a->hash == b->hash && a->size == b->size
+           && mismatchFactors(a->factors(), b->factors(), a->size) == a->size;
+  }
+
+  /// slot of the block equal to 'key', null if there is none
+  Data** find(const Data* key) {
+    if (slots.empty()) return nullptr;
+    const size_t mask = slots.size() - 1;
+    for (size_t i = key->hash & mask;; i = (i + 1) & mask) {
+      Data* d = slots[i];
+      if (!d) return nullptr;
+      if (d != tombstone() && equal(d, key)) return &slots[i];
+    }
+  }
+
+  /// adds a block which has no equal one in the table
+  void insert(Data* data) {
+    if (2 * (used + 1) > slots.size()) resize();
+    const size_t mask = slots.size() - 1;
+    size_t i = data->hash & mask;
+    while (slots[i] && slots[i] != tombstone()) i = (i + 1) & mask;
+    if (!slots[i]) used++;
+    slots[i] = data;
+    peak = std::max(peak, ++live);
+  }
+
+  void erase(Data** slot) {
+    *slot = tombstone();
+    live--;
+  }
+
+  /// rehashes the live blocks, dropping tombstones
+  void resize() {
+    size_t size = 1024;
+    while (size < 2 * (live + 1)) size *= 2;
+    std::vector<Data*> old(size, nullptr);
+    old.swap(slots);
+    used = live = 0;
+    for (Data* d : old) {
+      if (d && d != tombstone()) insert(d);
+    }
+  }
+};
+
+/// never destroyed, since blocks may still be released during exit
+static MonomialTable& monomialTable() {
+  static MonomialTable* table = new MonomialTable;
+  return *table;
+}
+
+void Monomial::destroy(Data* data) {
+  if (data->interned) {
+    MonomialTable& table = monomialTable();
+    std::lock_guard<std::mutex> lock(table.mutex);
+    Data** slot = table.find(data);
+    // an equal block may already have replaced this dying one
+    if (slot && *slot == data) table.erase(slot);
+  }
+  const bool in_arena = data->in_arena;
+  data->~Data();
+  if (!in_arena) ::operator delete(data);
+}
+
+Monomial::Interner::Interner() : lock_(monomialTable().mutex) {}
+
+Monomial Monomial::Interner::operator()(const Monomial& m) {
+  // returning the same block also guarantees that assigning the result
+  // never destroys an interned block while the lock is held
+  if (!m.data_ || m.data_->interned) return m;
+
+  MonomialTable& table = monomialTable();
+  if (Data** slot = table.find(m.data_)) {
+    // take a reference unless the block is already being destroyed
+    Data* d = *slot;
+    uint32_t refs = d->refs.load(std::memory_order_relaxed);
+    while (refs && !d->refs.compare_exchange_weak(refs, refs + 1, std::memory_order_relaxed)) {}
+    if (refs) {
+      Monomial shared;
+      shared.data_ = d;
+      return shared;
+    }
+    table.erase(slot);
+  }
+  Monomial shared = m;
+  if (m.data_->in_arena) {
+    // interned monomials outlive the rule
+    shared.release();
+    shared.data_ = allocate(m.size(), true);
+    memcpy(shared.data_->factors(), m.begin(), m.size() * sizeof(VarPower));
+    shared.data_->degree = m.data_->degree;
+    shared.data_->hash = m.data_->hash;
+  }
+  shared.data_->interned = 1;
+  table.insert(shared.data_);
+  return shared;
+}
+
+size_t Monomial::numInterned() {
+  MonomialTable& table = monomialTable();
+  std::lock_guard<std::mutex> lock(table.mutex);
+  return table.live;
+}
+
+size_t Monomial::peakInterned() {
+  MonomialTable& table = monomialTable();
+  std::lock_guard<std::mutex> lock(table.mutex);
+  return table.peak;
+}
+/*------------------------------------------------------------------------*/
+
+bool operator==(const Monomial& a, const Monomial& b) {
+  if (a.data_ == b.data_) return true;
+  if (a.hash() != b.hash() || a.size() != b.size()) return false;
+  return mismatchFactors(a.begin(), b.begin(), a.size()) == a.size();
+}
+
+/// orders by degree first and then lexicographically by the factors
+std::strong_ordering operator<=>(const Monomial& a, const Monomial& b) {
+  if (a.data_ == b.data_) return std::strong_ordering::equal;
+  if (auto c = a.degree() <=> b.degree(); c != 0) return c;
+  const VarPower* fa = a.begin();
+  const VarPower* fb = b.begin();
+  const uint32_t n = std::min(a.size(), b.size());
+  const uint32_t i = mismatchFactors(fa, fb, n);
+  if (i == n) return a.size() <=> b.size();
+  if (fa[i].var != fb[i].var) return fb[i].var <=> fa[i].var;
+  return fa[i].exp <=> fb[i].exp;
+}
+
+Monomial operator*(const Monomial& a, const Monomial& b) {
+  if (a.isConstant()) return b;
+  if (b.isConstant()) return a;
+
+  Monomial m;
+  m.data_ = Monomial::allocate(a.size() + b.size());
+  VarPower* out = m.data_->factors();
+  const VarPower *ia = a.begin(), *ea = a.end();
+  const VarPower *ib = b.begin(), *eb = b.end();
+  uint32_t n = 0;
+  while (ia != ea && ib != eb) {
+    if (ia->var < ib->var) {
+      out[n++] = *ia++;
+    } else if (ib->var < ia->var) {
+      out[n++] = *ib++;
+    } else {
+      out[n++] = {ia->var, idempotent ? 1u : ia->exp + ib->exp};
+      ++ia, ++ib;
+    }
+  }
+  while (ia != ea) out[n++] = *ia++;
+  while (ib != eb) out[n++] = *ib++;
+  m.data_->size = n;
+  m.finalize();
+  return m;
+}
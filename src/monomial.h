@@ -0,0 +1,143 @@
+/*------------------------------------------------------------------------*/
+/*! \file monomial.h
+    \brief variable interning table and packed monomials
+
+  Variables are interned once and afterwards only referred to by their
+  index. A monomial is an immutable, reference counted block holding the
+  sorted (variable, exponent) pairs together with a precomputed hash and
+  total degree, so that comparing, hashing and multiplying monomials only
+  touches integers. The reference count is atomic so that monomials can
+  be shared between checking threads.
+
+  With Boolean variables exponents are collapsed to 1 whenever a
+  monomial is built, so that x^2 = x holds for all variables.
+
+  Monomials of stored polynomials are interned, i.e. identical ones share
+  a single block, which leaves the table when its last reference goes.
+  Other blocks are allocated from the scratch arena of the current rule
+  if there is one. Interning copies them to the heap.
+
+  Part of Pacheck 3.0 : PAC proof checker.
+*/
+/*------------------------------------------------------------------------*/
+#ifndef PACHECK2_SRC_MONOMIAL_H_
+#define PACHECK2_SRC_MONOMIAL_H_
+/*------------------------------------------------------------------------*/
+#include <atomic>
+#include <compare>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <string_view>
+/*------------------------------------------------------------------------*/
+typedef uint32_t Var;
+
+/// one factor var^exp of a monomial
+struct VarPower {
+  Var var;
+  uint32_t exp;
+};
+/*------------------------------------------------------------------------*/
+// Variable table
+
+/// returns the index of 'name', adding it to the table if it is new
+Var internVariable(std::string_view name);
+
+/// returns the index of 'name' or -1 if it has not been interned
+int64_t findVariable(std::string_view name);
+
+/// returns the name of an interned variable
+const std::string& variableName(Var v);
+
+/// number of interned variables
+size_t numVariables();
+
+/// lets monomials built from now on by the calling thread treat all
+/// variables as Boolean, i.e. x^k = x for k > 0
+void setIdempotentVariables(bool enabled);
+
+/// whether variables are Boolean on the calling thread
+bool idempotentVariables();
+/*------------------------------------------------------------------------*/
+
+class Monomial {
+ public:
+  /// the constant monomial 1
+  Monomial() : data_(nullptr) {}
+  /// the monomial var^exp
+  Monomial(Var var, uint32_t exp);
+  /// builds a monomial from factors sorted by variable without duplicates
+  Monomial(const VarPower* factors, uint32_t size);
+
+  Monomial(const Monomial& other) : data_(other.data_) { retain(); }
+  Monomial(Monomial&& other) noexcept : data_(other.data_) { other.data_ = nullptr; }
+  Monomial& operator=(const Monomial& other);
+  Monomial& operator=(Monomial&& other) noexcept;
+  ~Monomial() { release(); }
+
+  bool isConstant() const { return data_ == nullptr; }
+  uint32_t size() const { return data_ ? data_->size : 0; }
+  uint32_t degree() const { return data_ ? data_->degree : 0; }
+  uint64_t hash() const { return data_ ? data_->hash : 0; }
+
+  const VarPower* begin() const { return data_ ? data_->factors() : nullptr; }
+  const VarPower* end() const { return begin() + size(); }
+
+  /// exponent of 'var' in this monomial (0 if it does not occur)
+  uint32_t exponent(Var var) const;
+
+  /// interns monomials while holding the lock of the interning table
+  class Interner {
+   public:
+    Interner();
+    /// the shared block equal to 'm', interning 'm' if it is new
+    Monomial operator()(const Monomial& m);
+
+   private:
+    std::unique_lock<std::mutex> lock_;
+  };
+
+  /// number of distinct interned monomials alive
+  static size_t numInterned();
+  /// maximum of numInterned so far
+  static size_t peakInterned();
+
+  friend bool operator==(const Monomial& a, const Monomial& b);
+  friend std::strong_ordering operator<=>(const Monomial& a, const Monomial& b);
+  friend Monomial operator*(const Monomial& a, const Monomial& b);
+
+ private:
+  friend struct MonomialTable;
+
+  struct Data {
+    std::atomic<uint32_t> refs;
+    uint32_t size;
+    uint32_t degree;
+    uint16_t interned;  // set once, before the block is shared further
+    uint16_t in_arena;  // freed in bulk with its scratch arena
+    uint64_t hash;
+
+    VarPower* factors() { return reinterpret_cast<VarPower*>(this + 1); }
+    const VarPower* factors() const {
+      return reinterpret_cast<const VarPower*>(this + 1);
+    }
+  };
+
+  static Data* allocate(uint32_t size, bool heap = false);
+  void finalize();
+  void retain() const {
+    if (data_) data_->refs.fetch_add(1, std::memory_order_relaxed);
+  }
+  void release();
+  static void destroy(Data* data);
+
+  Data* data_;
+};
+/*------------------------------------------------------------------------*/
+
+struct MonomialHash {
+  size_t operator()(const Monomial& m) const { return m.hash(); }
+};
+
+/*------------------------------------------------------------------------*/
+#endif  // PACHECK2_SRC_MONOMIAL_H_
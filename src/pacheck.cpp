@@ -5,41 +5,366 @@
     Part of Pacheck 3.0 : PAC proof checker.
 */
 /*------------------------------------------------------------------------*/
-#include "parser.h"
+#include "binary.h"
+#include "checker.h"
+#include "kernels.h"
+#include "memory.h"
+#include "profile.h"
+#include "reader.h"
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
 #include <iostream>
-#include <fstream>
+#include <memory>
+#include <mutex>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
 /*------------------------------------------------------------------------*/
 #define VERSION "3.0"
 /*------------------------------------------------------------------------*/
 
+static void usage() {
+  std::cerr << "Usage: ./pacheck [--threads N] [--probabilistic K] [--fingerprints]" << std::endl;
+  std::cerr << "                 [--stats=json] [--profile-rules N] [--eager-delete]" << std::endl;
+  std::cerr << "                 [--max-memory MB] [--kernels NAME] [--backward] [--boolean]" << std::endl;
+  std::cerr << "                 [--checkpoint-every N] [--resume FILE] [-s]" << std::endl;
+  std::cerr << "                 <input_file> [<target_file>]" << std::endl;
+  std::cerr << "       ./pacheck --batch <list_file> [--threads N] [<option> ...]" << std::endl;
+  std::cerr << "       ./pacheck --convert <input_file> <output_file>" << std::endl;
+  std::cerr << "  <input_file> may be gzip or xz compressed, '-' reads standard input," << std::endl;
+  std::cerr << "  proofs in the binary format (see --convert) are recognized" << std::endl;
+  std::cerr << "  <target_file> holds the polynomial the last linear combination derives" << std::endl;
+  std::cerr << "  -s | --no-target   do not check the target" << std::endl;
+  std::cerr << "  --backward         only verify the linear combinations the conclusion" << std::endl;
+  std::cerr << "                     depends on, found in a pre-pass (not on standard input)" << std::endl;
+  std::cerr << "  --boolean          treat all variables as Boolean, i.e. x^2 = x, which" << std::endl;
+  std::cerr << "                     excludes random evaluation" << std::endl;
+  std::cerr << "  --threads N        check linear combinations on N threads (0: all cores)," << std::endl;
+  std::cerr << "                     while the proof is parsed ahead on another one" << std::endl;
+  std::cerr << "  --probabilistic K  check linear combinations at K random points" << std::endl;
+  std::cerr << "  --fingerprints     check linear combinations by the fingerprints of the" << std::endl;
+  std::cerr << "                     polynomials, i.e. at one random point, on all threads" << std::endl;
+  std::cerr << "  --stats=json       report the statistics as JSON, timing the operations" << std::endl;
+  std::cerr << "                     (alone on stdout, other messages go to stderr)" << std::endl;
+  std::cerr << "  --profile-rules N  list the N slowest rules" << std::endl;
+  std::cerr << "  --eager-delete     delete polynomials after their last use, found in a" << std::endl;
+  std::cerr << "                     pre-pass over the proof (not on standard input)" << std::endl;
+  std::cerr << "  --max-memory MB    spill cold polynomials to disk beyond MB" << std::endl;
+  std::cerr << "  --kernels NAME     compare and hash monomials with 'scalar', 'sse4' or" << std::endl;
+  std::cerr << "                     'avx2' code (default: the best the CPU supports)" << std::endl;
+  std::cerr << "  --checkpoint-every N" << std::endl;
+  std::cerr << "                     save the state of the check every N rules, to the" << std::endl;
+  std::cerr << "                     file resumed from or to <input_file>.checkpoint" << std::endl;
+  std::cerr << "  --resume FILE      continue the check after the checkpoint in FILE" << std::endl;
+  std::cerr << "  --batch            check the proofs listed in <list_file> ('-' for standard" << std::endl;
+  std::cerr << "                     input), one per line optionally followed by a target" << std::endl;
+  std::cerr << "                     file, on N threads, printing one JSON line per proof" << std::endl;
+  std::cerr << "  --convert          write the textual proof in the binary format" << std::endl;
+}
+
+/// reads the lines of a textual proof, numbered from 1
+template <class F>
+static void forEachLine(ProofReader& reader, F process) {
+  std::string_view line;
+  for (int i = 1; nextProofLine(reader, line); ++i) process(line, i);
+}
+
+/// translates a textual proof into the binary format without checking it
+static int convert(ProofReader& reader, const char* input, const char* output) {
+  if (reader.startsWith(binary_proof_magic)) {
+    std::cerr << "Error: " << input << " already is a binary proof" << std::endl;
+    return 1;
+  }
+  BinaryProofWriter writer;
+  if (!writer.open(output)) {
+    std::cerr << "Error: Cannot create file " << output << " (" << writer.error() << ")" << std::endl;
+    return 1;
+  }
+  int rules = 0;
+  Checker checker;
+  try {
+    forEachLine(reader, [&](std::string_view line, int lineno) {
+      ArenaScope scratch;
+      Rule rule;
+      parseLine(line, lineno, rule);
+      // coefficients are reduced by the modulus
+      if (rule.kind == Rule::Mod) checker.processRule(rule, lineno);
+      writer.write(rule);
+      rules++;
+    });
+  } catch (const ProofError& error) {
+    std::cerr << error.diagnostics << std::flush;
+    return 1;
+  }
+  if (!reader.error().empty()) {
+    std::cerr << "Error: Cannot read file " << input << " (" << reader.error() << ")" << std::endl;
+    return 1;
+  }
+  if (!writer.close()) {
+    std::cerr << "Error: Cannot write file " << output << " (" << writer.error() << ")" << std::endl;
+    return 1;
+  }
+  std::cout << "Converted " << rules << " rules to binary proof " << output << " ("
+            << writer.bytesWritten() << " bytes)" << std::endl;
+  return 0;
+}
+
+/// reads the target polynomial, skipping empty and comment lines,
+/// returns false with the reason in 'error' on failure
+static bool readTarget(const char* path, std::string& target, std::string& error) {
+  ProofReader reader;
+  if (!reader.open(path)) {
+    error = "Cannot open target file " + std::string(path) + " (" + reader.error() + ")";
+    return false;
+  }
+  std::string_view line;
+  while (nextProofLine(reader, line)) target.append(line).push_back(' ');
+  if (!reader.error().empty()) {
+    error = "Cannot read target file " + std::string(path) + " (" + reader.error() + ")";
+    return false;
+  }
+  // an optional ';' ends the polynomial
+  size_t end = target.find_last_not_of(" \t\r");
+  if (end != std::string::npos && target[end] == ';') target.resize(end);
+  return true;
+}
+
+/// 's' as a JSON string
+static std::string jsonString(std::string_view s) {
+  std::string quoted = "\"";
+  for (char c : s) {
+    if (c == '"' || c == '\\') {
+      quoted.push_back('\\');
+      quoted.push_back(c);
+    } else if (static_cast<unsigned char>(c) < 32) {
+      char escaped[8];
+      snprintf(escaped, sizeof escaped, "\\u%04x", c);
+      quoted += escaped;
+    } else {
+      quoted.push_back(c);
+    }
+  }
+  return quoted + "\"";
+}
+
+/// checks the proofs listed in 'list', one per line optionally followed
+/// by a target file, on 'workers' threads, each proof with a checker of
+/// its own, printing one JSON line per proof as it finishes and a summary
+/// line, the threads keep their scratch arenas from proof to proof
+static int checkBatch(const char* list, const CheckerOptions& options, unsigned workers) {
+  ProofReader reader;
+  if (!reader.open(list)) {
+    std::cerr << "Error: Cannot open file " << list << " (" << reader.error() << ")" << std::endl;
+    return 1;
+  }
+  std::mutex mutex;  // guards the list, the output and the totals
+  size_t jobs = 0, failed = 0, proof_bytes = 0;
+  const uint64_t start = nanoseconds();
+
+  auto work = [&] {
+    std::ostream discard(nullptr);  // progress messages of the checkers
+    while (true) {
+      size_t job;
+      std::string proof, target;
+      {
+        std::lock_guard<std::mutex> lock(mutex);
+        std::string_view line;
+        do {
+          if (!reader.nextLine(line)) return;
+          std::istringstream fields{std::string(line)};
+          fields >> proof >> target;
+        } while (proof.empty() || proof[0] == '#');
+        job = ++jobs;
+      }
+      const uint64_t job_start = nanoseconds();
+      CheckerOptions job_options = options;
+      CheckResult result;
+      size_t bytes = 0;
+      std::string error;
+      if (!target.empty() && !readTarget(target.c_str(), job_options.target, error)) {
+        result = {false, 0, error, error + "\n"};
+      } else {
+        Checker checker(job_options, discard);
+        result = checker.check(proof);
+        bytes = checker.proofBytes();
+      }
+      std::ostringstream out;
+      out << "{\"job\": " << job << ", \"proof\": " << jsonString(proof)
+          << ", \"ok\": " << (result.ok ? "true" : "false");
+      if (!result.ok) {
+        out << ", \"line\": " << result.lineno << ", \"error\": " << jsonString(result.message);
+      }
+      out << ", \"bytes\": " << bytes << ", \"seconds\": " << secondsSince(job_start) << "}\n";
+
+      std::lock_guard<std::mutex> lock(mutex);
+      std::cout << out.str() << std::flush;
+      if (!result.ok) failed++;
+      proof_bytes += bytes;
+    }
+  };
+  std::vector<std::thread> threads;
+  for (unsigned i = 1; i < workers; ++i) threads.emplace_back(work);
+  work();
+  for (std::thread& thread : threads) thread.join();
+
+  if (!reader.error().empty()) {
+    std::cerr << "Error: Cannot read file " << list << " (" << reader.error() << ")" << std::endl;
+    return 1;
+  }
+  const double seconds = secondsSince(start);
+  std::cout << "{\"jobs\": " << jobs << ", \"failed\": " << failed << ", \"threads\": "
+            << workers << ", \"bytes\": " << proof_bytes << ", \"seconds\": " << seconds
+            << ", \"proofs_per_second\": " << (seconds > 0 ? jobs / seconds : 0)
+            << ", \"megabytes_per_second\": " << (seconds > 0 ? proof_bytes / seconds / 1e6 : 0)
+            << "}" << std::endl;
+  return failed ? 1 : 0;
+}
+
+/// parses a decimal option argument in [min, max]
+static bool parseCount(const char* arg, long min, long max, long& value) {
+  char* end;
+  value = strtol(arg, &end, 10);
+  return !*end && end != arg && value >= min && value <= max;
+}
+
 int main(int argc, char* argv[]) {
-  if (argc != 2) {
-    std::cerr << "Usage: ./pacheck <input_file>" << std::endl;
+  const char* input = nullptr;
+  const char* output = nullptr;
+  const char* target = nullptr;
+  const char* resume = nullptr;
+  const char* batch = nullptr;
+  long threads = 1, points = 0, profiled_rules = 0, max_memory = 0, checkpoint_every = 0;
+  bool json = false, eager_delete = false, fingerprints = false, backward = false;
+  bool no_target = false, boolean = false;
+  for (int i = 1; i < argc; ++i) {
+    if (!strcmp(argv[i], "--threads") && i + 1 < argc) {
+      if (!parseCount(argv[++i], 0, 1024, threads)) {
+        usage();
+        return 1;
+      }
+    } else if (!strcmp(argv[i], "--probabilistic") && i + 1 < argc) {
+      if (!parseCount(argv[++i], 1, 1024, points)) {
+        usage();
+        return 1;
+      }
+    } else if (!strcmp(argv[i], "--profile-rules") && i + 1 < argc) {
+      if (!parseCount(argv[++i], 1, 1000000, profiled_rules)) {
+        usage();
+        return 1;
+      }
+    } else if (!strcmp(argv[i], "--max-memory") && i + 1 < argc) {
+      if (!parseCount(argv[++i], 1, 1 << 30, max_memory)) {
+        usage();
+        return 1;
+      }
+    } else if (!strcmp(argv[i], "--checkpoint-every") && i + 1 < argc) {
+      if (!parseCount(argv[++i], 1, 1L << 30, checkpoint_every)) {
+        usage();
+        return 1;
+      }
+    } else if (!strcmp(argv[i], "--resume") && i + 1 < argc) {
+      resume = argv[++i];
+    } else if (!strcmp(argv[i], "--batch") && i + 1 < argc && !input) {
+      batch = argv[++i];
+    } else if (!strcmp(argv[i], "--kernels") && i + 1 < argc) {
+      if (!selectFactorKernels(argv[++i])) {
+        usage();
+        return 1;
+      }
+    } else if (!strcmp(argv[i], "--fingerprints")) {
+      fingerprints = true;
+    } else if (!strcmp(argv[i], "--eager-delete")) {
+      eager_delete = true;
+    } else if (!strcmp(argv[i], "--backward")) {
+      backward = true;
+    } else if (!strcmp(argv[i], "--boolean")) {
+      boolean = true;
+    } else if (!strcmp(argv[i], "-s") || !strcmp(argv[i], "--no-target")) {
+      no_target = true;
+    } else if (!strcmp(argv[i], "--stats=json") || !strcmp(argv[i], "--stats=text")) {
+      json = argv[i][8] == 'j';
+    } else if (!strcmp(argv[i], "--convert") && i + 2 < argc && !input) {
+      input = argv[++i];
+      output = argv[++i];
+    } else if (!input && (argv[i][0] != '-' || !argv[i][1])) {
+      input = argv[i];
+    } else if (input && !output && !target && argv[i][0] != '-') {
+      target = argv[i];
+    } else {
+      usage();
+      return 1;
+    }
+  }
+  const bool prepass = eager_delete || backward;
+  if ((!input && !batch) || (prepass && input && !strcmp(input, "-")) || (points && fingerprints)
+      || (boolean && (points || fingerprints))
+      || (batch && (input || resume || checkpoint_every || json))) {
+    usage();
     return 1;
   }
+  if (threads == 0) threads = std::max(1u, std::thread::hardware_concurrency());
+
+  CheckerOptions options;
+  options.probabilistic_points = points;
+  options.fingerprints = fingerprints;
+  options.eager_delete = eager_delete;
+  options.memory_limit = size_t(max_memory) << 20;
+  options.profiled_rules = profiled_rules;
+  options.backward = backward;
+  options.boolean = boolean;
+  // one proof per thread, results are the only output
+  if (batch) return checkBatch(batch, options, threads);
 
-  std::cout << "==========================================" << std::endl;
-  std::cout << "         Pacheck Proof Checker " << VERSION << std::endl;
-  std::cout << "==========================================" << std::endl;
+  // with JSON statistics they are the only output on stdout
+  std::ostream& log = json ? std::cerr : std::cout;
+  log << "==========================================" << std::endl;
+  log << "         Pacheck Proof Checker " << VERSION << std::endl;
+  log << "==========================================" << std::endl;
 
-  std::ifstream infile(argv[1]);
-  if (!infile.is_open()) {
-    std::cerr << "Error: Cannot open file " << argv[1] << std::endl;
+  ProofReader reader;
+  if (!reader.open(input)) {
+    std::cerr << "Error: Cannot open file " << input << " (" << reader.error() << ")" << std::endl;
     return 1;
   }
-  std::cout << "Pacheck reads proof from file: " << argv[1] << std::endl;
+  log << "Pacheck reads proof from file: " << input << std::endl;
+  if (output) return convert(reader, input, output);
 
-  std::string line;
-  int i = 1;
-  while (std::getline(infile, line)) {
-    if (line.empty() || line[0] == 'c') continue;  // skip empty and comment lines
-    processLine(line, i++);
+  options.threads = threads;
+  options.checkpoint_every = checkpoint_every;
+  if (resume) options.resume = options.checkpoint = resume;
+  else if (strcmp(input, "-")) options.checkpoint = std::string(input) + ".checkpoint";
+  else options.checkpoint = "pacheck.checkpoint";
+  std::string error;
+  if (target && !no_target && !readTarget(target, options.target, error)) {
+    std::cerr << "Error: " << error << std::endl;
+    return 1;
+  }
+  // before any checking thread starts
+  if (json) enableProfiling();
+  Checker checker(options, log);
+  if (prepass) {
+    LastMentions last;
+    std::unique_ptr<ProofCone> cone;
+    if (backward) cone.reset(new ProofCone);
+    if (!scanProof(input, eager_delete ? &last : nullptr, cone.get(), error)) {
+      std::cerr << "Error: Cannot read file " << input << " (" << error << ")" << std::endl;
+      return 1;
+    }
+    if (eager_delete) checker.setEagerDeletion(std::move(last));
+    if (backward) checker.setCone(std::move(cone));
+  }
+
+  CheckResult result = checker.check(reader, input);
+  if (!result.ok) {
+    std::cerr << result.diagnostics << std::flush;
+    return 1;
   }
 
-  printFinalStatistics();
-  std::cout << "Proof check completed successfully." << std::endl;
+  checker.printStatistics(std::cout, json);
+  log << "Proof check completed successfully." << std::endl;
 
-  infile.close();
   return 0;
 }
 
@@ -2,369 +2,385 @@
 /*! \file parser.cpp
     \brief core functions for parsing
 
+  Lines are classified by a hand-written scanner and operands are parsed
+  straight into polynomials. Tokens are views into the scanned line, so
+  no intermediate strings are built. Parsing keeps no state apart from
+  the modulus of the calling thread, which reduces the coefficients.
+
   Part of Pacheck 3.0 : PAC proof checker.
 */
 /*------------------------------------------------------------------------*/
 #include "parser.h"
 
-#include <iostream>
-#include <regex>
+#include <charconv>
+#include <cstring>
 #include <string>
-#include <unordered_set>
+#include "profile.h"
 /*------------------------------------------------------------------------*/
-std::unordered_map<int, Polynomial> id_to_poly;
-std::unordered_set<std::string> allowed_variables;
-std::vector<std::pair<std::string, int>> substitution_stack;
-std::unordered_map<std::string, std::unordered_set<int>> declared_roots;
+static bool isSpace(char ch) { return isspace(static_cast<unsigned char>(ch)); }
+static bool isDigit(char ch) { return isdigit(static_cast<unsigned char>(ch)); }
+static bool isAlpha(char ch) { return isalpha(static_cast<unsigned char>(ch)); }
+static bool isAlnum(char ch) { return isalnum(static_cast<unsigned char>(ch)); }
+
+static std::string_view trim(std::string_view s) {
+  size_t b = 0, e = s.size();
+  while (b < e && isSpace(s[b])) ++b;
+  while (e > b && isSpace(s[e - 1])) --e;
+  return s.substr(b, e - b);
+}
 
+/// parses a decimal number with optional sign, returns false on overflow
+template <class T>
+static bool toNumber(std::string_view s, T& value) {
+  auto [end, ec] = std::from_chars(s.data(), s.data() + s.size(), value);
+  return ec == std::errc() && end == s.data() + s.size();
+}
 /*------------------------------------------------------------------------*/
-int axiomrules = 0;  // Count of axiom rules processed
-int lincomb_rules = 0;  // Count of linear combination rules processed
-int branch_rules = 0;  // Count of branch rules processed
-int delete_rules = 0;  // Count of delete rules processed
-int root_rules = 0;  // Count of root rules processed
-/*------------------------------------------------------------------------*/
-int mod_value = -1;
-bool mod_set = false;
+ProofError proofError(int lineno, std::string message, const std::string& details) {
+  std::string diagnostics = details + "Error";
+  if (lineno) diagnostics += " (line " + std::to_string(lineno) + ")";
+  diagnostics += ": " + message + "\n";
+  return {lineno, std::move(message), std::move(diagnostics)};
+}
+
+/// a syntax error within an operand, which is reported without a
+/// prefix, the line is filled in by parseLine
+static ProofError syntaxError(std::string message) {
+  std::string diagnostics = message + "\n";
+  return {0, std::move(message), std::move(diagnostics)};
+}
 /*------------------------------------------------------------------------*/
-std::vector<Token> tokenize(const std::string& input) {
-  std::vector<Token> tokens;
-  std::string buffer;
-  for (size_t i = 0; i < input.size(); ++i) {
-    char ch = input[i];
-
-    if (isspace(ch)) continue;
-
-    if (isdigit(ch)) {
-      buffer = ch;
-      while (i + 1 < input.size() && isdigit(input[i + 1])) {
-        buffer += input[++i];
-      }
-      tokens.push_back({TokenType::Number, buffer});
-    } else if (isalpha(ch) || ch == 'l') {
-      buffer = ch;
-      while (i + 1 < input.size() && (isalnum(input[i + 1]) || input[i + 1] == '_')) {
-        buffer += input[++i];
-      }
-      tokens.push_back({TokenType::Identifier, buffer});
-    } else if (ch == '+' || ch == '-' || ch == '*' || ch == '^' || ch == '(' || ch == ')') {
-      tokens.push_back({TokenType::Operator, std::string(1, ch)});
-    } else {
-      std::cerr << "Unexpected character in input: " << ch << "\n";
-      exit(1);
-    }
+void Lexer::next() {
+  OperationScope scope(Operation::Tokenize);
+  while (pos < text.size() && isSpace(text[pos])) ++pos;
+  if (pos == text.size()) {
+    token = {TokenType::End, {}};
+    return;
   }
 
-  tokens.push_back({TokenType::End, ""});
-  return tokens;
+  size_t start = pos;
+  char ch = text[pos];
+  if (isDigit(ch)) {
+    while (pos < text.size() && isDigit(text[pos])) ++pos;
+    token = {TokenType::Number, text.substr(start, pos - start)};
+  } else if (isAlpha(ch)) {
+    while (++pos < text.size() && (isAlnum(text[pos]) || text[pos] == '_')) {}
+    token = {TokenType::Identifier, text.substr(start, pos - start)};
+  } else if (ch && strchr("+-*^()", ch)) {
+    ++pos;
+    token = {TokenType::Operator, text.substr(start, 1)};
+  } else {
+    throw syntaxError(std::string("Unexpected character in input: ") + ch);
+  }
+}
+
+static bool isOperator(const Token& token, char op) {
+  return token.type == TokenType::Operator && token.value[0] == op;
 }
 /*------------------------------------------------------------------------*/
-Polynomial parseTerm(std::vector<Token>& tokens, size_t& i) {
-  Polynomial result = parseFactor(tokens, i);
+Polynomial parseTerm(Lexer& lex) {
+  Polynomial result = parseFactor(lex);
 
-  while (tokens[i].type == TokenType::Operator && tokens[i].value == "*") {
-    ++i;  // skip '*'
-    Polynomial rhs = parseFactor(tokens, i);
+  while (isOperator(lex.token, '*')) {
+    lex.next();  // skip '*'
+    Polynomial rhs = parseFactor(lex);
     result = multiplyPolynomials(result, rhs);
   }
 
   return result;
 }
 /*------------------------------------------------------------------------*/
-Polynomial parseExpression(std::vector<Token>& tokens, size_t& i) {
-  Polynomial result = parseTerm(tokens, i);
-
-  while (tokens[i].type == TokenType::Operator && (tokens[i].value == "+" || tokens[i].value == "-")) {
-    std::string op = tokens[i++].value;
-    Polynomial rhs = parseTerm(tokens, i);
-    if (op == "+") {
-      result = addPolynomials(result, rhs);
-    } else {
-      rhs = multiplyPolynomialByConstant(rhs, -1);
-      result = addPolynomials(result, rhs);
-    }
+Polynomial parseExpression(Lexer& lex) {
+  // the terms of proofs are mostly printed in order, so collecting them
+  // and sorting once is linear for them
+  TermVector terms;
+  Polynomial first = parseTerm(lex);
+  terms.assign(first.begin(), first.end());
+
+  while (isOperator(lex.token, '+') || isOperator(lex.token, '-')) {
+    bool minus = isOperator(lex.token, '-');
+    lex.next();
+    Polynomial rhs = parseTerm(lex);
+    for (const Term& t : rhs) terms.push_back({t.mono, minus ? negCoeff(t.coeff) : t.coeff});
   }
 
-  return result;
+  return Polynomial(std::move(terms));
 }
 /*------------------------------------------------------------------------*/
-Polynomial parseFactor(std::vector<Token>& tokens, size_t& i) {
+Polynomial parseFactor(Lexer& lex) {
   int sign = 1;
 
   // Handle unary minus
-  while (tokens[i].type == TokenType::Operator && (tokens[i].value == "-" || tokens[i].value == "+")) {
-    if (tokens[i].value == "-") sign *= -1;
-    ++i;
+  while (isOperator(lex.token, '-') || isOperator(lex.token, '+')) {
+    if (isOperator(lex.token, '-')) sign *= -1;
+    lex.next();
   }
 
-  if (tokens[i].type == TokenType::Number) {
-    int coeff = std::stoi(tokens[i++].value);
+  if (lex.token.type == TokenType::Number) {
+    Coeff coeff = coeffFromDigits(lex.token.value);
+    if (sign < 0) coeff = negCoeff(coeff);
+    lex.next();
 
-    if (tokens[i].type == TokenType::Operator && tokens[i].value == "*") {
-      ++i;
-      Polynomial p = parseFactor(tokens, i);
-      return multiplyPolynomialByConstant(p, sign * coeff);
+    if (isOperator(lex.token, '*')) {
+      lex.next();
+      Polynomial p = parseFactor(lex);
+      return multiplyPolynomialByConstant(p, coeff);
     } else {
-      return makePolynomial(sign * coeff);
+      return makePolynomial(coeff);
     }
   }
 
-  if (tokens[i].type == TokenType::Identifier) {
-    std::string var = tokens[i++].value;
-    int exp = 1;
+  if (lex.token.type == TokenType::Identifier) {
+    Var var = internVariable(lex.token.value);
+    uint32_t exp = 1;
+    lex.next();
 
-    if (tokens[i].type == TokenType::Operator && tokens[i].value == "^") {
-      ++i;
-      if (tokens[i].type != TokenType::Number) {
-        std::cerr << "Expected exponent after '^'\n";
-        exit(1);
+    if (isOperator(lex.token, '^')) {
+      lex.next();
+      if (lex.token.type != TokenType::Number || !toNumber(lex.token.value, exp)) {
+        throw syntaxError("Expected exponent after '^'");
       }
-      exp = std::stoi(tokens[i++].value);
+      lex.next();
     }
 
-    Monomial mono = {{var, exp}};
-    return makePolynomial(sign, mono);
+    // x^0 is the constant 1, x does not occur in the polynomial then
+    return makePolynomial(coeffFromInt(sign), Monomial(var, exp));
   }
 
-  if (tokens[i].type == TokenType::Operator && tokens[i].value == "(") {
-    ++i;  // skip '('
-    Polynomial p = parseExpression(tokens, i);
-    if (tokens[i].value != ")") {
-      std::cerr << "Expected ')' in expression\n";
-      exit(1);
-    }
-    ++i;  // skip ')'
-    return multiplyPolynomialByConstant(p, sign);
+  if (isOperator(lex.token, '(')) {
+    lex.next();  // skip '('
+    Polynomial p = parseExpression(lex);
+    if (!isOperator(lex.token, ')')) throw syntaxError("Expected ')' in expression");
+    lex.next();  // skip ')'
+    return multiplyPolynomialByConstant(p, coeffFromInt(sign));
   }
 
-  std::cerr << "Unexpected token in expression\n";
-  exit(1);
+  throw syntaxError("Unexpected token in expression");
 }
 /*------------------------------------------------------------------------*/
-
-
-
-Polynomial parsePolynomial(const std::string& input) {
-  std::vector<Token> tokens = tokenize(input);
-  size_t index = 0;
-  return parseExpression(tokens, index);
+Polynomial parsePolynomial(std::string_view input) {
+  Lexer lex(input);
+  Polynomial p = parseExpression(lex);
+  // trailing tokens are ignored but still have to be valid
+  while (lex.token.type != TokenType::End) lex.next();
+  return p;
 }
 /*------------------------------------------------------------------------*/
-void handleModRule(const std::smatch& match, int lineno) {
-  if (mod_set) {
-    std::cerr << "Error (line " << lineno << "): 'mod' rule already set.\n";
-    exit(1);
-  }
-  mod_value = std::stoi(match[1]);
-  mod_set = true;
+[[noreturn]] static void invalidLine(std::string_view line, int lineno) {
+  throw proofError(lineno, "Unrecognized or invalid line:\n" + std::string(line));
 }
-
 /*------------------------------------------------------------------------*/
-void handleAxiomRule(const std::smatch& match, int lineno) {
-  int id = std::stoi(match[1]);
-  if(id_to_poly.find(id) != id_to_poly.end()) {
-    std::cerr << "Error (line " << lineno << "): Axiom rule ID " << id << " already exists.\n";
-    exit(1);
-  }
-  if (!mod_set) {
-    std::cerr << "Error (line " << lineno << "): 'mod' rule must be set before axiom rules.\n";
-    exit(1);
-  }
+static void mention(int id, int lineno, LastMentions& last) { last[id] = lineno; }
 
-  Polynomial poly = parsePolynomial(match[2]);
-  std::unordered_set<std::string> vars = getVariables(poly);
-  allowed_variables.insert(vars.begin(), vars.end());
-  id_to_poly[id] = poly;
+void recordMentions(const RuleIds& ids, int lineno, LastMentions& last) {
+  if (ids.kind == Rule::Mod || ids.kind == Rule::Branch) return;
+  mention(ids.id, lineno, last);
+  for (int id : ids.antecedents) mention(id, lineno, last);
 }
 
-/*------------------------------------------------------------------------*/
-void handleDeleteRule(const std::smatch& match, int lineno) {
-  if(id_to_poly.find(std::stoi(match[1])) == id_to_poly.end()) {
-    std::cerr << "Error (line " << lineno << "): Delete rule for unknown ID.\n";
-    exit(1);
-  }
-
-  int id = std::stoi(match[1]);
-  id_to_poly.erase(id);
+void ruleIds(const Rule& rule, RuleIds& ids) {
+  ids.kind = rule.kind;
+  ids.id = rule.id;
+  ids.antecedents.clear();
+  for (const auto& product : rule.products) ids.antecedents.push_back(product.first);
 }
-
 /*------------------------------------------------------------------------*/
-void handleLinCombRule(const std::smatch& match, int lineno) {
-  int target_id = std::stoi(match[1]);
-  std::string operations = match[2];
-  std::string result_str = match[3];
-
-  Polynomial result;
-  std::regex term_regex(R"((\d+)\s*\*\s*\(([^)]+)\))");
-  auto it = std::sregex_iterator(operations.begin(), operations.end(), term_regex);
-  auto end = std::sregex_iterator();
-
-  for (; it != end; ++it) {
-    int poly_id = std::stoi((*it)[1]);
-    std::string multiplier_expr = (*it)[2];
-
-    if (id_to_poly.find(poly_id) == id_to_poly.end()) {
-      std::cerr << "Error (line " << lineno << "): Unknown polynomial ID " << poly_id << "\n";
-      exit(1);
-    }
+// Line scanner
 
-    const Polynomial& base = id_to_poly[poly_id];
-    Polynomial multiplier = parsePolynomial(multiplier_expr);
+struct LineScanner {
+  std::string_view line;
+  size_t pos = 0;
 
-    if (!isSubset(getVariables(multiplier), allowed_variables)) {
-      std::cerr << "Error (line " << lineno << "): Invalid multiplier introduces new variables\n";
-      exit(1);
-    }
-
-    Polynomial term = multiplyPolynomials(base, multiplier);
-    result = addPolynomials(result, term);
+  bool atEnd() const { return pos == line.size(); }
+  bool eat(char ch) {
+    if (pos < line.size() && line[pos] == ch) return ++pos, true;
+    return false;
   }
-
-  Polynomial expected = parsePolynomial(result_str);
-
-  if (!polynomialsEqual(result, expected)) {
-    std::cerr << "Error (line " << lineno << "): Mismatch in proof for ID " << target_id << "\n";
-    exit(1);
+  /// skips white space and returns whether there was any
+  bool skipSpace() {
+    size_t start = pos;
+    while (pos < line.size() && isSpace(line[pos])) ++pos;
+    return pos != start;
   }
-
-  id_to_poly[target_id] = expected;
-
-  if (polynomialsOne(expected)) {
-    while (!substitution_stack.empty()) {
-      auto [var, value] = substitution_stack.back();
-      substitution_stack.pop_back();
-      declared_roots[var].erase(value);
-      std::cout << "Derived 1 under assumption " << var << " = " << value << "\n";
-      std::cout << "Removed root " << value << " for variable " << var << "\n";
-
-      if (declared_roots[var].empty()) {
-        std::cout << "▶ All roots for variable " << var << " resolved — closing branch.\n";
-        declared_roots.erase(var);
-        current_substitution.clear();
-        for (const auto& [v, val] : substitution_stack) {
-          current_substitution[v] = val;
-        }
-      } else {
-        std::cout << "Remaining roots for variable " << var << ": ";
-        for (int root : declared_roots[var]) {
-          std::cout << root << " ";
-        }
-        std::cout << "\n";
-        break;
-      }
-    }
-
-    if (declared_roots.empty()) {
-      std::cout << "No active substitutions left.\n";
-    } else {
-      std::cout << "Active substitutions: ";
-      for (const auto& [var, val] : substitution_stack) {
-        std::cout << var << "=" << val << " ";
-      }
-      std::cout << "\n";
-    }
+  std::string_view digits() {
+    size_t start = pos;
+    while (pos < line.size() && isDigit(line[pos])) ++pos;
+    return line.substr(start, pos - start);
   }
-}
-
-/*------------------------------------------------------------------------*/
-void handleRootRule(const std::smatch& match, int lineno) {
-  int id = std::stoi(match[1]);
-  std::string var = match[2];
-  std::istringstream roots_stream(match[3]);
-  std::vector<int> roots;
-  int r;
-  while (roots_stream >> r) {
-    roots.push_back(r);
+  std::string_view signedDigits() {
+    size_t start = pos;
+    eat('-');
+    if (digits().empty()) pos = start;
+    return line.substr(start, pos - start);
   }
-
-  if (id_to_poly.find(id) == id_to_poly.end()) {
-    std::cerr << "Error (line " << lineno << "): Unknown polynomial ID " << id << " in root rule.\n";
-    exit(1);
+  std::string_view identifier() {
+    size_t start = pos;
+    if (pos < line.size() && (isAlpha(line[pos]) || line[pos] == '_')) {
+      while (++pos < line.size() && (isAlnum(line[pos]) || line[pos] == '_')) {}
+    }
+    return line.substr(start, pos - start);
   }
-
-  Polynomial poly = id_to_poly[id];
-
-  if (!isUnivariateIn(poly, var)) {
-    std::cerr << "Error (line " << lineno << "): Polynomial ID " << id << " is not univariate in variable '" << var << "'\n";
-    exit(1);
+  std::string_view rest() const { return line.substr(pos); }
+  /// accepts an optional ';' followed by the end of the line
+  bool finish() {
+    skipSpace();
+    eat(';');
+    skipSpace();
+    return atEnd();
   }
+};
 
-  for (int root : roots) {
-    int eval = evaluateAt(poly, var, root);
-    if (eval != 0) {
-      std::cerr << "Error (line " << lineno << "): " << root << " is not a root of polynomial ID " << id << "\n";
-      exit(1);
-    }
-
-    declared_roots[var].insert(root);
-  }
+/// strips an optional trailing ';' from a trimmed operand
+static std::string_view operand(std::string_view s) {
+  s = trim(s);
+  if (!s.empty() && s.back() == ';') s = trim(s.substr(0, s.size() - 1));
+  return s;
 }
 
-/*------------------------------------------------------------------------*/
-void handleBranchRule(const std::smatch& match, int lineno) {
-  std::string var = match[1];
-  int value = std::stoi(match[2]);
-
-  if (declared_roots.count(var) == 0 || declared_roots[var].count(value) == 0) {
-    std::cerr << "Error (line " << lineno << "): Instantiation of " << var << " = " << value
-              << " is invalid — root not declared.\n";
-    exit(1);
+/// parses the operands 'id * (multiplier)' of a '%' rule
+static void parseProducts(std::string_view operations, std::string_view line, int lineno,
+                          std::vector<std::pair<int, Polynomial>>& products) {
+  Lexer lex(operations);
+  while (true) {
+    int poly_id;
+    if (lex.token.type != TokenType::Number || !toNumber(lex.token.value, poly_id))
+      invalidLine(line, lineno);
+    lex.next();
+    if (!isOperator(lex.token, '*')) invalidLine(line, lineno);
+    lex.next();
+    if (!isOperator(lex.token, '(')) invalidLine(line, lineno);
+    lex.next();
+
+    Polynomial multiplier = parseExpression(lex);
+    if (!isOperator(lex.token, ')')) throw syntaxError("Expected ')' in expression");
+    lex.next();
+    products.emplace_back(poly_id, std::move(multiplier));
+
+    if (lex.token.type == TokenType::End) break;
+    if (!isOperator(lex.token, '+')) invalidLine(line, lineno);
+    lex.next();
   }
-
-  substitution_stack.emplace_back(var, value);
-  current_substitution[var] = value;
-
-  std::cout << "Branch on " << var << " = " << value << std::endl;
 }
 
 /*------------------------------------------------------------------------*/
-void processLine(std::string line, int lineno) {
+static void parseRule(std::string_view line, int lineno, Rule& rule) {
   size_t comment_pos = line.find("//");
-  if (comment_pos != std::string::npos) {
+  if (comment_pos != std::string_view::npos) {
     line = line.substr(0, comment_pos);
   }
 
-  line = std::regex_replace(line, std::regex("^\\s+|\\s+$"), "");
-
-  std::smatch match;
-  static std::regex axiom_rule(R"(^\s*(\d+)\s+a\s+(.+?)\s*;?\s*$)");
-  static std::regex delete_rule(R"(^\s*(\d+)\s+d\s*;?\s*$)");
-  static std::regex mod_rule(R"(^\s*m\s+(\d+)\s*;?\s*$)");
-  static std::regex linComb_rule(R"(^\s*(\d+)\s*%\s*(.+?)\s*,\s*(.+?)\s*;?\s*$)");
-  static std::regex branch_rule(R"(^\s*b\s+([a-zA-Z_][a-zA-Z0-9_]*)\s+(-?\d+)\s*;?\s*$)");
-  static std::regex root_rule(R"(^\s*(\d+)\s*r\s+([a-zA-Z_][a-zA-Z0-9_]*)\s+((?:-?\d+\s*)+)\s*;?\s*$)");
-
-  if (std::regex_match(line, match, mod_rule)) {
-    handleModRule(match, lineno);
-  } else if (std::regex_match(line, match, axiom_rule)) {
-    handleAxiomRule(match, lineno);
-    axiomrules++;
-  } else if (std::regex_match(line, match, delete_rule)) {
-    handleDeleteRule(match, lineno);
-    delete_rules++;
-  } else if (std::regex_match(line, match, linComb_rule)) {
-    handleLinCombRule(match, lineno);
-    lincomb_rules++;
-  } else if (std::regex_match(line, match, root_rule)) {
-    handleRootRule(match, lineno);
-    root_rules++;
-  } else if (std::regex_match(line, match, branch_rule)) {
-    handleBranchRule(match, lineno);
-    branch_rules++;
+  line = trim(line);
+  LineScanner s{line};
+
+  if (s.eat('m')) {
+    // m <modulus>
+    if (!s.skipSpace()) invalidLine(line, lineno);
+    rule.kind = Rule::Mod;
+    rule.text = s.digits();
+    if (rule.text.empty() || !s.finish()) invalidLine(line, lineno);
+  } else if (s.eat('b')) {
+    // b <variable> <value>
+    if (!s.skipSpace()) invalidLine(line, lineno);
+    rule.kind = Rule::Branch;
+    rule.text = s.identifier();
+    if (rule.text.empty() || !s.skipSpace()) invalidLine(line, lineno);
+    rule.var = internVariable(rule.text);
+    int value;
+    if (!toNumber(s.signedDigits(), value) || !s.finish()) invalidLine(line, lineno);
+    rule.values.push_back(value);
   } else {
-    std::cerr << "Error (line " << lineno << "): Unrecognized or invalid line:\n" << line << std::endl;
-    exit(1);
+    if (!toNumber(s.digits(), rule.id)) invalidLine(line, lineno);
+    bool space = s.skipSpace();
+
+    if (space && s.eat('a')) {
+      // <id> a <polynomial>
+      if (!s.skipSpace()) invalidLine(line, lineno);
+      std::string_view poly = operand(s.rest());
+      if (poly.empty()) invalidLine(line, lineno);
+      rule.kind = Rule::Axiom;
+      rule.poly = parsePolynomial(poly);
+    } else if (space && s.eat('d')) {
+      // <id> d
+      if (!s.finish()) invalidLine(line, lineno);
+      rule.kind = Rule::Delete;
+    } else if (s.eat('%')) {
+      // <id> % <id> * (<polynomial>) + ... , <polynomial>
+      std::string_view rest = s.rest();
+      size_t comma = rest.find(',');
+      if (comma == std::string_view::npos) invalidLine(line, lineno);
+      std::string_view operations = trim(rest.substr(0, comma));
+      std::string_view result = operand(rest.substr(comma + 1));
+      if (operations.empty() || result.empty()) invalidLine(line, lineno);
+      rule.kind = Rule::LinComb;
+      parseProducts(operations, line, lineno, rule.products);
+      rule.poly = parsePolynomial(result);
+    } else if (s.eat('r')) {
+      // <id> r <variable> <root> ...
+      if (!s.skipSpace()) invalidLine(line, lineno);
+      rule.kind = Rule::Root;
+      rule.text = s.identifier();
+      if (rule.text.empty() || !s.skipSpace()) invalidLine(line, lineno);
+      rule.var = internVariable(rule.text);
+      int root;
+      while (toNumber(s.signedDigits(), root)) {
+        rule.values.push_back(root);
+        s.skipSpace();
+      }
+      if (rule.values.empty() || !s.finish()) invalidLine(line, lineno);
+    } else {
+      invalidLine(line, lineno);
+    }
   }
 }
-/*------------------------------------------------------------------------*/
 
+void parseLine(std::string_view line, int lineno, Rule& rule) {
+  OperationScope scope(Operation::Parse);
+  try {
+    parseRule(line, lineno, rule);
+  } catch (ProofError& error) {
+    if (!error.lineno) error.lineno = lineno;
+    throw;
+  }
+}
 
-void printFinalStatistics() {
-  
-  std::cout << "  Axiom rules processed: " << axiomrules << "\n";
-  std::cout << "  Linear combination rules processed: " << lincomb_rules << "\n";
-  std::cout << "  Branch rules processed: " << branch_rules << "\n";
-  std::cout << "  Delete rules processed: " << delete_rules << "\n";
-  std::cout << "  Root rules processed: " << root_rules << "\n";
-
+bool scanRuleIds(std::string_view line, RuleIds& ids) {
+  size_t comment_pos = line.find("//");
+  if (comment_pos != std::string_view::npos) line = line.substr(0, comment_pos);
+  LineScanner s{trim(line)};
+  ids.id = 0;
+  ids.antecedents.clear();
+  if (s.eat('m')) {
+    ids.kind = Rule::Mod;
+    return true;
+  }
+  if (s.eat('b')) {
+    ids.kind = Rule::Branch;
+    return true;
+  }
+  if (!toNumber(s.digits(), ids.id)) return false;
+  bool space = s.skipSpace();
+  if (space && s.eat('a')) {
+    ids.kind = Rule::Axiom;
+  } else if (space && s.eat('d')) {
+    ids.kind = Rule::Delete;
+  } else if (s.eat('r')) {
+    ids.kind = Rule::Root;
+  } else if (s.eat('%')) {
+    ids.kind = Rule::LinComb;
+    // antecedents are the numbers outside the parenthesized multipliers
+    int depth = 0, id;
+    while (!s.atEnd() && s.line[s.pos] != ',') {
+      const char ch = s.line[s.pos];
+      if (!depth && isDigit(ch)) {
+        if (toNumber(s.digits(), id)) ids.antecedents.push_back(id);
+        continue;
+      }
+      if (ch == '(') depth++;
+      else if (ch == ')') depth--;
+      s.pos++;
+    }
+  } else {
+    return false;
+  }
+  return true;
 }
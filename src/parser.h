@@ -8,36 +8,85 @@
 #ifndef PACHECK2_SRC_PARSER_H_
 #define PACHECK2_SRC_PARSER_H_
 /*------------------------------------------------------------------------*/
-#include <vector>
-#include <map>
 #include <string>
+#include <string_view>
 #include <unordered_map>
+#include <vector>
 #include "polynomial.hpp"
 /*------------------------------------------------------------------------*/
-/// name of the input file
-
-extern std::unordered_map<int, Polynomial> id_to_poly;
-extern std::vector<std::pair<std::string, int>> substitution_stack;
-
-extern std::unordered_map<std::string, std::unordered_set<int>> declared_roots;
 
+/// ends the check of a proof, thrown by the parser and by the checker
+struct ProofError {
+  int lineno;               // of the rule, 0 if the error is not tied to one
+  std::string message;      // what is wrong
+  std::string diagnostics;  // the report printed for it, including 'message'
+};
 
+/// the error "Error (line N): 'message'" of rule 'lineno', reported
+/// after 'details', or "Error: 'message'" if 'lineno' is 0
+ProofError proofError(int lineno, std::string message, const std::string& details = "");
 
 enum class TokenType { Number, Identifier, Operator, End };
 
 struct Token {
     TokenType type;
-    std::string value;
+    std::string_view value;
+};
+
+/// splits a polynomial into tokens on demand
+struct Lexer {
+    std::string_view text;
+    size_t pos = 0;
+    Token token;
+
+    explicit Lexer(std::string_view input) : text(input) { next(); }
+    /// advances 'token' to the next token
+    void next();
 };
 /*------------------------------------------------------------------------*/
 // Functions
 
-Polynomial parseFactor(std::vector<Token>& tokens, size_t& index);
+Polynomial parseFactor(Lexer& lex);
+
+Polynomial parsePolynomial(std::string_view input);
 
 // Interpreter
-void processLine(std::string line, int lineno);
 
-void printFinalStatistics();
+/// a proof rule, parsed from a line or decoded from a binary record
+struct Rule {
+  enum Kind { Mod, Axiom, Delete, LinComb, Root, Branch };
+  Kind kind = Mod;
+  int id = 0;        // target ID of 'a', 'd', '%' and 'r'
+  std::string text;  // modulus digits of 'm', variable name of 'r' and 'b'
+  Var var = 0;       // interned variable of 'r' and 'b'
+  std::vector<std::pair<int, Polynomial>> products;  // antecedent ID and multiplier
+  Polynomial poly;          // axiom, or conclusion of '%'
+  std::vector<int> values;  // roots of 'r', value of 'b'
+  size_t end = 0;           // bytes of a textual proof up to the end of the rule
+};
+
+/// parses a line of a textual proof, throws ProofError on syntax errors
+void parseLine(std::string_view line, int lineno, Rule& rule);
+
+/// the IDs of a rule, found without parsing its polynomials
+struct RuleIds {
+  Rule::Kind kind = Rule::Mod;
+  int id = 0;                    // target ID of 'a', 'd', '%' and 'r'
+  std::vector<int> antecedents;  // of '%'
+};
+
+/// scans the IDs of a line of a textual proof, returns false for an
+/// invalid line, which is left to the check
+bool scanRuleIds(std::string_view line, RuleIds& ids);
+
+/// the IDs of a parsed or decoded rule
+void ruleIds(const Rule& rule, RuleIds& ids);
+
+/// the last line mentioning each polynomial ID, from a pre-pass
+typedef std::unordered_map<int, int> LastMentions;
+
+/// records the IDs mentioned by a rule
+void recordMentions(const RuleIds& ids, int lineno, LastMentions& last);
 
 /*------------------------------------------------------------------------*/
 #endif  // PACHECK2_SRC_PARSER_H_
@@ -0,0 +1,128 @@
+/*------------------------------------------------------------------------*/
+/*! \file pipeline.cpp
+    \brief parsing rules ahead of the checks on a thread of their own
+
+  Part of Pacheck 3.0 : PAC proof checker.
+*/
+/*------------------------------------------------------------------------*/
+#include "pipeline.h"
+#include "memory.h"
+
+#include <exception>
+#include <thread>
+#include <vector>
+/*------------------------------------------------------------------------*/
+static const size_t num_batches = 4;     // parsed ahead at most
+static const size_t batch_rules = 256;   // a batch is handed over when full
+static const size_t batch_chunks = 2;    // or when its arena grew this large
+/*------------------------------------------------------------------------*/
+
+/// consecutive rules, allocated from the arena of the batch
+struct Batch {
+  Arena arena;
+  std::vector<Rule> rules;
+  std::vector<int> linenos;
+  std::exception_ptr error;  // syntax error after the rules
+  bool last = false;         // no further batch follows
+};
+
+struct Pipeline {
+  Pipeline(const RuleSource& source, int first_lineno)
+      : source(source), first_lineno(first_lineno), context(ArithmeticContext::current()) {}
+
+  void produce();
+  /// ends the parsing thread early, i.e. when checking failed
+  void stop();
+
+  const RuleSource& source;
+  const int first_lineno;
+  Batch batches[num_batches];
+  SpscQueue<Batch*, num_batches> ready;          // parsed, in rule order
+  SpscQueue<Batch*, num_batches + 1> recycled;   // drained, null stops
+  ArithmeticContext context;                     // of the main thread
+  std::atomic<bool> modulus_set{false};          // the 'm' rule was processed
+  std::atomic<bool> stopping{false};
+  std::thread parser;
+};
+
+void Pipeline::produce() {
+  PhaseScope phase(Phase::Parse);
+  int lineno = first_lineno;
+  for (bool last = false; !last;) {
+    Batch* batch = recycled.pop();
+    if (!batch) return;
+    batch->arena.reset();
+    bool wait_for_modulus = false;
+    {
+      // written by the main thread only while waiting for the modulus
+      ArithmeticScope arithmetic(context);
+      ArenaScope scope(batch->arena);
+      while (batch->rules.size() < batch_rules && batch->arena.chunksUsed() < batch_chunks) {
+        Rule& rule = batch->rules.emplace_back();
+        bool parsed = false;
+        try {
+          parsed = source(rule, lineno);
+        } catch (...) {
+          batch->error = std::current_exception();
+        }
+        if (!parsed) {
+          batch->rules.pop_back();
+          last = true;
+          break;
+        }
+        batch->linenos.push_back(lineno++);
+        if (rule.kind == Rule::Mod) {
+          wait_for_modulus = true;
+          break;
+        }
+      }
+    }
+    batch->last = last;
+    ready.push(batch);
+    if (wait_for_modulus) {
+      modulus_set.wait(false, std::memory_order_acquire);
+      modulus_set.store(false, std::memory_order_relaxed);
+    }
+    if (stopping.load(std::memory_order_acquire)) return;
+  }
+}
+
+void Pipeline::stop() {
+  stopping.store(true, std::memory_order_release);
+  modulus_set.store(true, std::memory_order_release);
+  modulus_set.notify_one();
+  recycled.push(nullptr);
+  parser.join();
+}
+
+void checkPipelined(const RuleSource& source, const RuleSink& process, int first_lineno) {
+  std::unique_ptr<Pipeline> pipeline(new Pipeline(source, first_lineno));
+  for (Batch& batch : pipeline->batches) pipeline->recycled.push(&batch);
+  pipeline->parser = std::thread(&Pipeline::produce, pipeline.get());
+
+  try {
+    for (bool last = false; !last;) {
+      Batch* batch = pipeline->ready.pop();
+      for (size_t i = 0; i < batch->rules.size(); ++i) {
+        ArenaScope scratch;  // as in processLine
+        PhaseScope phase(Phase::Parse);
+        Rule& rule = batch->rules[i];
+        process(rule, batch->linenos[i]);
+        if (rule.kind == Rule::Mod) {
+          pipeline->context = ArithmeticContext::current();
+          pipeline->modulus_set.store(true, std::memory_order_release);
+          pipeline->modulus_set.notify_one();
+        }
+      }
+      if (batch->error) std::rethrow_exception(batch->error);
+      last = batch->last;
+      batch->rules.clear();  // before the arena is reset
+      batch->linenos.clear();
+      pipeline->recycled.push(batch);
+    }
+  } catch (...) {
+    pipeline->stop();
+    throw;
+  }
+  pipeline->parser.join();
+}
@@ -0,0 +1,80 @@
+/*------------------------------------------------------------------------*/
+/*! \file pipeline.h
+    \brief parsing rules ahead of the checks on a thread of their own
+
+  A parsing thread turns the input into batches of rules, each allocated
+  from a scratch arena owned by the batch, and hands them to the main
+  thread through a bounded single-producer single-consumer ring. The
+  main thread processes the rules in order, exactly as processLine does,
+  and returns the drained batch through a second ring, so at most a fixed
+  number of batches is ever parsed ahead (backpressure).
+
+  Parsing depends on the checking state in one way only: coefficients
+  are reduced by the modulus, so after an 'm' rule the parser waits until
+  it has been processed and takes over the arithmetic settings of the
+  main thread. Syntax errors are passed along with the batch and thrown
+  once all earlier rules are processed. An error thrown by processing
+  stops the parsing thread and is passed on.
+
+  Part of Pacheck 3.0 : PAC proof checker.
+*/
+/*------------------------------------------------------------------------*/
+#ifndef PACHECK2_SRC_PIPELINE_H_
+#define PACHECK2_SRC_PIPELINE_H_
+/*------------------------------------------------------------------------*/
+#include <atomic>
+#include <cstddef>
+#include <functional>
+#include "parser.h"
+/*------------------------------------------------------------------------*/
+
+/// bounded lock-free ring between one producing and one consuming thread,
+/// blocking on the indices (C++20 atomic wait) when full or empty
+template <class T, size_t N>
+class SpscQueue {
+ public:
+  /// appends 'item', waits while the ring is full
+  void push(T item) {
+    const size_t tail = tail_.load(std::memory_order_relaxed);
+    size_t head;
+    while (tail - (head = head_.load(std::memory_order_acquire)) == N) {
+      head_.wait(head, std::memory_order_acquire);
+    }
+    items_[tail % N] = item;
+    tail_.store(tail + 1, std::memory_order_release);
+    tail_.notify_one();
+  }
+
+  /// removes the oldest item, waits while the ring is empty
+  T pop() {
+    const size_t head = head_.load(std::memory_order_relaxed);
+    while (tail_.load(std::memory_order_acquire) == head) {
+      tail_.wait(head, std::memory_order_acquire);
+    }
+    T item = items_[head % N];
+    head_.store(head + 1, std::memory_order_release);
+    head_.notify_one();
+    return item;
+  }
+
+ private:
+  alignas(64) std::atomic<size_t> head_{0};  // written by the consumer
+  alignas(64) std::atomic<size_t> tail_{0};  // written by the producer
+  T items_[N];
+};
+
+/// parses the next rule within the current scratch arena scope into
+/// 'rule' and returns true, or returns false at the end of the input,
+/// throws ProofError on a syntax error of rule 'lineno'
+typedef std::function<bool(Rule& rule, int lineno)> RuleSource;
+
+/// checks and applies a rule of line 'lineno'
+typedef std::function<void(Rule& rule, int lineno)> RuleSink;
+
+/// passes the rules of 'source', which is called on a parsing thread, in
+/// order to 'process', each within a scratch arena scope of its own,
+/// numbering them from 'first_lineno'
+void checkPipelined(const RuleSource& source, const RuleSink& process, int first_lineno = 1);
+
+/*------------------------------------------------------------------------*/
+#endif  // PACHECK2_SRC_PIPELINE_H_
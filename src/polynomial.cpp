@@ -1,208 +1,468 @@
 #include "polynomial.hpp"
-#include <cmath>
+#include <algorithm>
+#include <random>
+#include "memory.h"
+#include "profile.h"
+#include "threadpool.h"
 
+/// products with at least this many term pairs are split across threads
+static const size_t parallel_multiply_threshold = 1 << 15;
+/// minimal number of term pairs handled by one task
+static const size_t parallel_multiply_block = 1 << 12;
 
-std::unordered_map<std::string, int> current_substitution;
+static thread_local ThreadPool* multiply_pool = nullptr;
 
-int mod(int x) {
-    if (mod_value <= 0) return x; // no mod set
-    int r = x % mod_value;
-    return r < 0 ? r + mod_value : r;
-}
+void setMultiplyPool(ThreadPool* pool) { multiply_pool = pool; }
 //------------------------------------------------------------------------
-Polynomial makePolynomial(int coeff, const Monomial& mono) {
-    Polynomial p;
-    if (mod(coeff) != 0) {
-        p[mono] = mod(coeff);
+// Fingerprints
+
+/// drawn once per run, so that no proof can aim at the random point
+static const uint64_t fingerprint_seed =
+    (uint64_t(std::random_device{}()) << 32) ^ std::random_device{}();
+
+static thread_local bool fingerprints = false;
+
+void setFingerprints(bool enabled) { fingerprints = enabled; }
+
+bool fingerprintsEnabled() {
+#ifdef PACHECK_GMP
+    return fingerprints && modulus != 0;
+#else
+    return fingerprints;
+#endif
+}
+
+ArithmeticContext ArithmeticContext::current() {
+    return {::modulus, ::fingerprints, idempotentVariables(), ::multiply_pool};
+}
+
+ArithmeticScope::ArithmeticScope(const ArithmeticContext& context)
+    : saved_(ArithmeticContext::current()) {
+    modulus = context.modulus;
+    fingerprints = context.fingerprints;
+    setIdempotentVariables(context.idempotent);
+    multiply_pool = context.multiply_pool;
+}
+
+ArithmeticScope::~ArithmeticScope() {
+    modulus = saved_.modulus;
+    fingerprints = saved_.fingerprints;
+    setIdempotentVariables(saved_.idempotent);
+    multiply_pool = saved_.multiply_pool;
+}
+
+/// the coordinate of 'var' of the random point, cached per thread since
+/// variables are added while checks run, and left unreduced, which
+/// mulCoeff and powCoeff accept, so moduli beyond 2^64 are sampled at
+/// 2^64 residues only (see the error bound in checker.cpp)
+static uint64_t pointCoordinate(Var var) {
+    thread_local std::vector<uint64_t> coordinates;
+    while (coordinates.size() <= var) {
+        uint64_t x = fingerprint_seed + (coordinates.size() + 1) * 0x9E3779B97F4A7C15ull;
+        x = (x ^ (x >> 30)) * 0xBF58476D1CE4E5B9ull;
+        x = (x ^ (x >> 27)) * 0x94D049BB133111EBull;
+        coordinates.push_back(x ^ (x >> 31));
     }
-    return p;
+    return coordinates[var];
 }
 
+static Coeff evaluateMonomial(const Monomial& mono) {
+    Coeff value = coeffFromInt(1);
+    for (const auto& [var, exp] : mono) {
+        const Coeff v = static_cast<unsigned long>(pointCoordinate(var));
+        value = mulCoeff(value, exp == 1 ? v : powCoeff(v, exp));
+    }
+    return value;
+}
 //------------------------------------------------------------------------
-Polynomial addPolynomials(const Polynomial& a, const Polynomial& b) {
-    Polynomial result = a;
+static bool greaterMonomial(const Term& a, const Term& b) {
+    return a.mono > b.mono;
+}
 
-    for (const auto& [mono, coeff] : b) {
-        result[mono] += coeff;
-        result[mono] = mod(result[mono]);
+Polynomial::Polynomial(TermVector terms) : terms_(std::move(terms)) {
+    if (!std::is_sorted(terms_.begin(), terms_.end(), greaterMonomial))
+        std::sort(terms_.begin(), terms_.end(), greaterMonomial);
+
+    // Combine like terms and drop zero coefficients
+    size_t n = 0;
+    for (size_t i = 0; i < terms_.size(); ) {
+        Coeff coeff = terms_[i].coeff;
+        size_t j = i + 1;
+        for (; j < terms_.size() && terms_[j].mono == terms_[i].mono; ++j) {
+            coeff = addCoeff(coeff, terms_[j].coeff);
+        }
+        if (coeff != 0) {
+            if (n != i) terms_[n].mono = std::move(terms_[i].mono);
+            terms_[n++].coeff = std::move(coeff);
+        }
+        i = j;
+    }
+    terms_.resize(n);
 
-        // Remove zero terms
-        if (result[mono] == 0) {
-            result.erase(mono);
+    if (!fingerprintsEnabled()) return;
+    for (const auto& [mono, coeff] : terms_) {
+        fingerprint_ = addCoeff(fingerprint_, mulCoeff(coeff, evaluateMonomial(mono)));
+    }
+}
+//------------------------------------------------------------------------
+void Polynomial::makePersistent() {
+    HeapScope heap;
+    TermVector terms(terms_.begin(), terms_.end());
+    Monomial::Interner intern;
+    for (Term& t : terms) t.mono = intern(t.mono);
+    terms_.swap(terms);
+}
+//------------------------------------------------------------------------
+Polynomial makePolynomial(const Coeff& coeff, const Monomial& mono) {
+    return Polynomial({{mono, coeff}});
+}
+
+//------------------------------------------------------------------------
+Polynomial addPolynomials(const Polynomial& a, const Polynomial& b) {
+    OperationScope scope(Operation::Add);
+    Polynomial result;
+    TermVector& out = result.terms_;
+    out.reserve(a.size() + b.size());
+
+    const Term *ia = a.begin(), *ea = a.end();
+    const Term *ib = b.begin(), *eb = b.end();
+    while (ia != ea && ib != eb) {
+        auto cmp = ia->mono <=> ib->mono;
+        if (cmp > 0) {
+            out.push_back(*ia++);
+        } else if (cmp < 0) {
+            out.push_back(*ib++);
+        } else {
+            Coeff coeff = addCoeff(ia->coeff, ib->coeff);
+            // Remove zero terms
+            if (coeff != 0) out.push_back({ia->mono, coeff});
+            ++ia, ++ib;
         }
     }
+    out.insert(out.end(), ia, ea);
+    out.insert(out.end(), ib, eb);
+    result.fingerprint_ = addCoeff(a.fingerprint_, b.fingerprint_);
 
     return result;
 }
 
 //------------------------------------------------------------------------
-Polynomial multiplyPolynomialByConstant(const Polynomial& poly, int c) {
+Polynomial multiplyPolynomialByConstant(const Polynomial& poly, const Coeff& c) {
     Polynomial result;
     for (const auto& [mono, coeff] : poly) {
-        int new_coeff = mod(coeff * c);
+        Coeff new_coeff = mulCoeff(coeff, c);
         if (new_coeff != 0) {
-            result[mono] = new_coeff;
+            result.terms_.push_back({mono, new_coeff});
         }
     }
+    result.fingerprint_ = mulCoeff(poly.fingerprint_, c);
     return result;
 }
 //------------------------------------------------------------------------
+/// product of the terms [begin, end) with 'b', summing the sorted
+/// products of the single terms instead of sorting all products at once
+static Polynomial multiplyTerms(const Term* begin, const Term* end, const Polynomial& b) {
+    PolynomialAccumulator products;
+    for (const Term* t = begin; t != end; ++t) products.addProduct(*t, b);
+    return products.sum();
+}
+
+/// splits the longer factor into blocks whose products are computed and
+/// then summed pairwise in parallel
+static Polynomial multiplyParallel(const Polynomial& a, const Polynomial& b) {
+    const Polynomial& split = a.size() >= b.size() ? a : b;
+    const Polynomial& other = a.size() >= b.size() ? b : a;
+
+    size_t pairs = split.size() * other.size();
+    size_t blocks = std::min<size_t>(4 * multiply_pool->size(), pairs / parallel_multiply_block);
+    blocks = std::clamp<size_t>(blocks, 1, split.size());
+
+    std::vector<Polynomial> parts(blocks);
+    const ArithmeticContext context = ArithmeticContext::current();
+    // results are handed between threads, so they do not use scratch arenas
+    multiply_pool->parallelFor(blocks, [&](size_t i) {
+        ArithmeticScope arithmetic(context);
+        HeapScope heap;
+        const Term* begin = split.begin() + split.size() * i / blocks;
+        const Term* end = split.begin() + split.size() * (i + 1) / blocks;
+        parts[i] = multiplyTerms(begin, end, other);
+    });
+
+    while (parts.size() > 1) {
+        std::vector<Polynomial> sums((parts.size() + 1) / 2);
+        multiply_pool->parallelFor(parts.size() / 2, [&](size_t i) {
+            ArithmeticScope arithmetic(context);
+            HeapScope heap;
+            sums[i] = addPolynomials(parts[2 * i], parts[2 * i + 1]);
+        });
+        if (parts.size() % 2) sums.back() = std::move(parts.back());
+        parts.swap(sums);
+    }
+    return std::move(parts[0]);
+}
+
 Polynomial multiplyPolynomials(const Polynomial& a, const Polynomial& b) {
+    OperationScope scope(Operation::Multiply);
+    if (multiply_pool && a.size() * b.size() >= parallel_multiply_threshold) {
+        return multiplyParallel(a, b);
+    }
+    // few long products of single terms are summed faster than many short,
+    // on ties the terms of 'b' are taken, which is the next factor when
+    // parsing and has the monomial of fewer factors to fingerprint
+    if (a.size() >= b.size()) return multiplyTerms(b.begin(), b.end(), a);
+    return multiplyTerms(a.begin(), a.end(), b);
+}
+
+//------------------------------------------------------------------------
+/// bucket of the accumulator for 'size' terms
+static size_t bucketIndex(size_t size) {
+    size_t i = 0;
+    while (size > size_t(4) << (2 * i)) ++i;
+    return i;
+}
+
+// the parts are owned, so their terms are moved instead of copied, which
+// saves updating the reference counts of the monomials
+Polynomial PolynomialAccumulator::merge(Polynomial& a, Polynomial& b) {
+    OperationScope scope(Operation::Add);
     Polynomial result;
+    TermVector& out = result.terms_;
+    out.reserve(a.size() + b.size());
+
+    Term *ia = a.terms_.data(), *ea = ia + a.size();
+    Term *ib = b.terms_.data(), *eb = ib + b.size();
+    while (ia != ea && ib != eb) {
+        auto cmp = ia->mono <=> ib->mono;
+        if (cmp > 0) {
+            out.push_back(std::move(*ia++));
+        } else if (cmp < 0) {
+            out.push_back(std::move(*ib++));
+        } else {
+            Coeff coeff = addCoeff(ia->coeff, ib->coeff);
+            if (coeff != 0) out.push_back({std::move(ia->mono), std::move(coeff)});
+            ++ia, ++ib;
+        }
+    }
+    out.insert(out.end(), std::make_move_iterator(ia), std::make_move_iterator(ea));
+    out.insert(out.end(), std::make_move_iterator(ib), std::make_move_iterator(eb));
+    result.fingerprint_ = addCoeff(a.fingerprint_, b.fingerprint_);
+    a = Polynomial();
+    b = Polynomial();
+    return result;
+}
 
-    for (const auto& [ma, ca] : a) {
-        for (const auto& [mb, cb] : b) {
-            Monomial m;
-            // Combine exponents
-            m = ma;
-            for (const auto& [var, exp] : mb) {
-                m[var] += exp;
-            }
+void PolynomialAccumulator::add(Polynomial p) {
+    if (p.empty()) return;
+    for (size_t i = bucketIndex(p.size());; ++i) {
+        if (i >= buckets_.size()) buckets_.resize(i + 1);
+        Polynomial& bucket = buckets_[i];
+        if (!bucket.empty()) p = merge(bucket, p);
+        if (p.size() <= size_t(4) << (2 * i)) {
+            bucket = std::move(p);
+            return;
+        }
+    }
+}
 
-            int coeff = mod(ca * cb);
-            if (coeff != 0) {
-                result[m] += coeff;
-                result[m] = mod(result[m]);
-                if (result[m] == 0) result.erase(m);
-            }
+void PolynomialAccumulator::addProduct(const Term& term, const Polynomial& poly) {
+    // multiplying by a monomial preserves the order of the terms, except
+    // for products collapsed by Boolean variables, which are summed apart
+    Polynomial product;
+    product.terms_.reserve(poly.size());
+    TermVector collapsed;
+    const bool idempotent = idempotentVariables();
+    for (const auto& [mono, coeff] : poly) {
+        Coeff c = mulCoeff(term.coeff, coeff);
+        if (c == 0) continue;
+        Monomial m = term.mono * mono;
+        if (idempotent && m.degree() < term.mono.degree() + mono.degree()) {
+            collapsed.push_back({std::move(m), c});
+        } else {
+            product.terms_.push_back({std::move(m), c});
         }
     }
+    if (!collapsed.empty()) add(Polynomial(std::move(collapsed)));
+    if (fingerprintsEnabled()) {
+        product.fingerprint_ =
+            mulCoeff(mulCoeff(term.coeff, evaluateMonomial(term.mono)), poly.fingerprint_);
+    }
+    add(std::move(product));
+}
+
+Polynomial PolynomialAccumulator::sum() {
+    OperationScope scope(Operation::Add);
+    ScratchVector<Polynomial> parts;
+    for (Polynomial& bucket : buckets_) {
+        if (!bucket.empty()) parts.push_back(std::move(bucket));
+    }
+    buckets_.clear();
 
+    Polynomial result;
+    if (parts.size() == 1) {
+        result = std::move(parts[0]);
+    } else if (parts.size() == 2) {
+        result = merge(parts[0], parts[1]);
+    } else if (!parts.empty()) {
+        // n-way merge of the sorted buckets through a heap of cursors
+        struct Cursor { Term* pos; Term* end; };
+        ScratchVector<Cursor> heap;
+        size_t total = 0;
+        for (Polynomial& p : parts) {
+            heap.push_back({p.terms_.data(), p.terms_.data() + p.size()});
+            total += p.size();
+            result.fingerprint_ = addCoeff(result.fingerprint_, p.fingerprint_);
+        }
+        auto lower = [](const Cursor& x, const Cursor& y) {
+            return x.pos->mono < y.pos->mono;
+        };
+        std::make_heap(heap.begin(), heap.end(), lower);
+
+        TermVector& out = result.terms_;
+        out.reserve(total);
+        while (!heap.empty()) {
+            std::pop_heap(heap.begin(), heap.end(), lower);
+            Cursor& c = heap.back();
+            if (!out.empty() && out.back().mono == c.pos->mono) {
+                out.back().coeff = addCoeff(out.back().coeff, c.pos->coeff);
+            } else {
+                if (!out.empty() && out.back().coeff == 0) out.pop_back();
+                out.push_back(std::move(*c.pos));
+            }
+            if (++c.pos == c.end) heap.pop_back();
+            else std::push_heap(heap.begin(), heap.end(), lower);
+        }
+        if (!out.empty() && out.back().coeff == 0) out.pop_back();
+    }
     return result;
 }
 
 //------------------------------------------------------------------------
-Polynomial substitute(const Polynomial& poly, const std::unordered_map<std::string, int>& subs) {
-    Polynomial result;
+Polynomial substitute(const Polynomial& poly, const std::unordered_map<Var, int>& subs) {
+    OperationScope scope(Operation::Substitute);
+    TermVector terms;
+    terms.reserve(poly.size());
+    ScratchVector<VarPower> kept;
 
     for (const auto& [monomial, coeff] : poly) {
-        int numeric_factor = coeff;
-        Monomial new_monomial;
+        Coeff numeric_factor = coeff;
+        kept.clear();
 
         for (const auto& [var, exp] : monomial) {
             auto it = subs.find(var);
             if (it != subs.end()) {
                 // Variable is substituted: multiply numeric_factor by (value^exp)
-                numeric_factor *= static_cast<int>(std::pow(it->second, exp));
-                numeric_factor = mod(numeric_factor);
+                numeric_factor = mulCoeff(numeric_factor, powCoeff(coeffFromInt(it->second), exp));
             } else {
                 // Variable not substituted: keep in monomial
-                new_monomial[var] = exp;
+                kept.push_back({var, exp});
             }
         }
 
-        // Add to result
         if (numeric_factor != 0) {
-            // Combine like terms:
-            result[new_monomial] += numeric_factor;
-            result[new_monomial] = mod(result[new_monomial]);
+            terms.push_back({Monomial(kept.data(), kept.size()), numeric_factor});
         }
     }
 
-    // Remove zero coeff monomials if needed
-    for (auto it = result.begin(); it != result.end(); ) {
-        if (it->second == 0) it = result.erase(it);
-        else ++it;
-    }
-
-    return result;
+    // Combines like terms and removes zero coefficients
+    return Polynomial(std::move(terms));
 }
 //------------------------------------------------------------------------
-bool polynomialsEqual(const Polynomial& a, const Polynomial& b) {
-    if (a == b) return true;
-
-    Polynomial a_sub = substitute(a, current_substitution);
-    Polynomial b_sub = substitute(b, current_substitution);
-    if (a_sub == b_sub) return true;
-
-
-    // If they are not equal, print the polynomials for debugging
-
-    std::cerr << "Polynomials do not match:\n";
-    std::cerr << "Expected (RHS): ";
-    printPolynomial(b_sub);
-    std::cerr << "\nComputed (LHS): ";
-    printPolynomial(a_sub);
-    std::cerr << "\n\n";
-
-    return false;
-}
-
-//------------------------------------------------------------------------
-bool polynomialsOne(const Polynomial& a) {
-    Polynomial b = makePolynomial(1);
-    if (a == b) return true;
-
-    Polynomial a_sub = substitute(a, current_substitution);
-    if (a_sub == b) return true;
-
-
-    return false;
+void printMismatch(std::ostream& out, const Polynomial& computed, const Polynomial& expected,
+                   const std::unordered_map<Var, int>& subs) {
+    out << "Polynomials do not match:\n";
+    out << "Expected (RHS): ";
+    printPolynomial(substitute(expected, subs), out);
+    out << "\nComputed (LHS): ";
+    printPolynomial(substitute(computed, subs), out);
+    out << "\n\n";
 }
 
 //------------------------------------------------------------------------
-bool isUnivariateIn(const Polynomial& p, const std::string& var) {
+bool univariateTerms(const Polynomial& p, Var var, UnivariateTerms& terms) {
+    terms.clear();
+    terms.reserve(p.size());
+    // terms are sorted by degree first, which is the exponent here
     for (const auto& [mono, coeff] : p) {
-        for (const auto& [v, _] : mono) {
-            if (v != var)
-                return false;
+        if (mono.degree() == 0) {
+            terms.emplace_back(0, coeff);
+            continue;
         }
+        if (mono.size() != 1 || mono.begin()->var != var)
+            return false;
+        terms.emplace_back(mono.begin()->exp, coeff);
     }
     return true;
 }
 //------------------------------------------------------------------------
-int evaluateAt(const Polynomial& p, const std::string& var, int value) {
-    int result = 0;
-    for (const auto& [mono, coeff] : p) {
-        int term = coeff;
-        for (const auto& [v, exp] : mono) {
-            if (v != var)
-                return -1; // multivariate, should not happen if univariate check passed
-            int pow_val = 1;
-            for (int i = 0; i < exp; ++i)
-                pow_val = mod(pow_val * value);
-            term = mod(term * pow_val);
+void evaluateUnivariate(const UnivariateTerms& terms, const std::vector<Coeff>& points,
+                        std::vector<Coeff>& values) {
+    values.assign(points.size(), Coeff(0));
+    // values = values * x^gap + c from the highest exponent down, where
+    // gaps are 1 for dense polynomials
+    for (size_t t = 0; t < terms.size(); ++t) {
+        const auto& [exp, coeff] = terms[t];
+        const uint32_t gap = t ? terms[t - 1].first - exp : 0;
+        for (size_t i = 0; i < points.size(); ++i) {
+            Coeff& value = values[i];
+            if (gap == 1) value = mulCoeff(value, points[i]);
+            else if (gap > 1) value = mulCoeff(value, powCoeff(points[i], gap));
+            value = addCoeff(value, coeff);
         }
-        result = mod(result + term);
     }
-    return result;
+    // below the lowest exponent
+    const uint32_t low = terms.empty() ? 0 : terms.back().first;
+    if (low == 0) return;
+    for (size_t i = 0; i < points.size(); ++i)
+        values[i] = mulCoeff(values[i], powCoeff(points[i], low));
 }
 //------------------------------------------------------------------------
 
-void printPolynomial(const Polynomial& p) {
+void printPolynomial(const Polynomial& p, std::ostream& out) {
     if (p.empty()) {
-        std::cout << "0";
+        out << "0";
         return;
     }
 
-    bool first = true;
+    // print in the order of the variable names, independent of the
+    // interning order of the variables
+    typedef std::vector<std::pair<std::string, uint32_t>> NamedMonomial;
+    std::vector<std::pair<NamedMonomial, Coeff>> named;
     for (const auto& [mono, coeff] : p) {
-        int c = mod(coeff);
+        NamedMonomial nm;
+        for (const auto& [var, exp] : mono) nm.emplace_back(variableName(var), exp);
+        std::sort(nm.begin(), nm.end());
+        named.emplace_back(std::move(nm), coeff);
+    }
+    std::sort(named.begin(), named.end());
+
+    bool first = true;
+    for (const auto& [mono, coeff] : named) {
+        const Coeff& c = coeff;
         if (c == 0) continue;
 
         // Sign
         if (!first) {
-            if (c > 0) std::cout << " + ";
-            else std::cout << " - ";
+            if (!isNegativeCoeff(c)) out << " + ";
+            else out << " - ";
         } else {
-            if (c < 0) std::cout << "-";
+            if (isNegativeCoeff(c)) out << "-";
         }
 
-        int abs_c = std::abs(c);
+        Coeff abs_c = isNegativeCoeff(c) ? Coeff(0 - c) : c;
         bool need_coeff = (abs_c != 1 || mono.empty());
 
-        if (need_coeff) std::cout << abs_c;
+        if (need_coeff) out << abs_c;
 
         for (const auto& [var, exp] : mono) {
             if (!need_coeff) {
                 // if no coeff, don't add `*`
-                std::cout << var;
+                out << var;
             } else {
-                std::cout << "*" << var;
+                out << "*" << var;
             }
 
             if (exp != 1) {
-                std::cout << "^" << exp;
+                out << "^" << exp;
             }
 
             need_coeff = true; // All further variables must be prefixed with '*'
@@ -214,19 +474,23 @@ void printPolynomial(const Polynomial& p) {
 //------------------------------------------------------------------------
 
 
-std::unordered_set<std::string> getVariables(const Polynomial& poly) {
-    std::unordered_set<std::string> vars;
+std::vector<Var> getVariables(const Polynomial& poly) {
+    std::vector<Var> vars;
     for (const auto& [mono, coeff] : poly) {
         for (const auto& [var, exp] : mono) {
-            vars.insert(var);
+            vars.push_back(var);
         }
     }
+    std::sort(vars.begin(), vars.end());
+    vars.erase(std::unique(vars.begin(), vars.end()), vars.end());
     return vars;
 }
 //------------------------------------------------------------------------
-bool isSubset(const std::unordered_set<std::string>& small, const std::unordered_set<std::string>& large) {
-    for (const auto& v : small) {
-        if (!large.count(v)) return false;
+bool allVariablesAllowed(const Polynomial& poly, const std::vector<bool>& allowed) {
+    for (const auto& [mono, coeff] : poly) {
+        for (const auto& [var, exp] : mono) {
+            if (var >= allowed.size() || !allowed[var]) return false;
+        }
     }
     return true;
 }
@@ -0,0 +1,169 @@
+/*------------------------------------------------------------------------*/
+/*! \file polynomial.hpp
+    \brief polynomial arithmetic modulo the proof modulus
+
+  Part of Pacheck 3.0 : PAC proof checker.
+*/
+/*------------------------------------------------------------------------*/
+#ifndef PACHECK2_SRC_POLYNOMIAL_HPP_
+#define PACHECK2_SRC_POLYNOMIAL_HPP_
+/*------------------------------------------------------------------------*/
+#include <iostream>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+#include "coefficient.h"
+#include "memory.h"
+#include "monomial.h"
+/*------------------------------------------------------------------------*/
+
+struct Term {
+    Monomial mono;
+    Coeff coeff;
+
+    friend bool operator==(const Term&, const Term&) = default;
+};
+
+/// terms of temporaries are allocated from the scratch arena of the rule
+typedef ScratchVector<Term> TermVector;
+
+/// A polynomial is a vector of terms ordered by decreasing monomials,
+/// without zero coefficients and with each monomial occurring once.
+///
+/// If enabled, every polynomial carries a fingerprint, its value at a
+/// random point drawn once per run. Evaluation respects the ring
+/// operations, so sums, scaled polynomials and products get their
+/// fingerprint from those of their parts in constant time, and
+/// polynomials with different fingerprints are unequal without comparing
+/// terms. Equality compares terms only if the fingerprints agree.
+class Polynomial {
+ public:
+    Polynomial() = default;
+    /// builds a polynomial from unordered terms with reduced coefficients
+    explicit Polynomial(TermVector terms);
+
+    size_t size() const { return terms_.size(); }
+    bool empty() const { return terms_.empty(); }
+    const Term* begin() const { return terms_.data(); }
+    const Term* end() const { return terms_.data() + terms_.size(); }
+    const Term& operator[](size_t i) const { return terms_[i]; }
+
+    /// zero for all polynomials if fingerprints are disabled
+    const Coeff& fingerprint() const { return fingerprint_; }
+
+    /// moves the terms out of the scratch arena to the heap and replaces
+    /// the monomials by their interned copies, for polynomials which
+    /// outlive the current rule
+    void makePersistent();
+
+    friend bool operator==(const Polynomial& a, const Polynomial& b) {
+        return a.fingerprint_ == b.fingerprint_ && a.terms_ == b.terms_;
+    }
+
+ private:
+    friend class PolynomialAccumulator;
+    friend Polynomial addPolynomials(const Polynomial& a, const Polynomial& b);
+    friend Polynomial multiplyPolynomialByConstant(const Polynomial& poly, const Coeff& c);
+
+    TermVector terms_;
+    Coeff fingerprint_ = 0;
+};
+
+/// Sums many polynomials in a geobucket: bucket i holds a partial sum of
+/// at most 4^(i+1) terms, an added polynomial is merged into the bucket
+/// of its size and the merged sum moves up while it overflows, so every
+/// term is merged a logarithmic number of times and cancelling terms
+/// disappear early instead of being kept until the end.
+class PolynomialAccumulator {
+ public:
+    void add(Polynomial p);
+    /// adds the product of 'term' and 'poly'
+    void addProduct(const Term& term, const Polynomial& poly);
+    /// returns the sum of all added polynomials and clears the accumulator
+    Polynomial sum();
+
+ private:
+    /// merges 'a' and 'b' by moving their terms
+    static Polynomial merge(Polynomial& a, Polynomial& b);
+
+    ScratchVector<Polynomial> buckets_;
+};
+
+/// lets polynomials built from now on by the calling thread carry
+/// fingerprints
+void setFingerprints(bool enabled);
+
+/// whether polynomials get fingerprints, which needs a bounded modulus
+bool fingerprintsEnabled();
+
+class ThreadPool;
+
+/// the settings of the arithmetic, which belong to the calling thread so
+/// that proofs can be checked side by side, and are captured to carry
+/// them over to the threads working for a check
+struct ArithmeticContext {
+    Modulus modulus;
+    bool fingerprints;
+    bool idempotent;  // variables are Boolean (see setIdempotentVariables)
+    ThreadPool* multiply_pool;
+
+    /// the settings of the calling thread
+    static ArithmeticContext current();
+};
+
+/// installs 'context' on the calling thread until destroyed
+class ArithmeticScope {
+ public:
+    explicit ArithmeticScope(const ArithmeticContext& context);
+    ArithmeticScope(const ArithmeticScope&) = delete;
+    ArithmeticScope& operator=(const ArithmeticScope&) = delete;
+    ~ArithmeticScope();
+
+ private:
+    ArithmeticContext saved_;
+};
+/*------------------------------------------------------------------------*/
+// Functions
+
+Polynomial makePolynomial(const Coeff& coeff, const Monomial& mono = Monomial());
+
+Polynomial addPolynomials(const Polynomial& a, const Polynomial& b);
+
+Polynomial multiplyPolynomialByConstant(const Polynomial& poly, const Coeff& c);
+
+/// large products are computed on the pool set by setMultiplyPool
+Polynomial multiplyPolynomials(const Polynomial& a, const Polynomial& b);
+
+/// lets multiplyPolynomials on the calling thread split large products
+/// across 'pool' (may be null)
+void setMultiplyPool(ThreadPool* pool);
+
+Polynomial substitute(const Polynomial& poly, const std::unordered_map<Var, int>& subs);
+
+/// prints both sides of a failed comparison after applying 'subs'
+void printMismatch(std::ostream& out, const Polynomial& computed, const Polynomial& expected,
+                   const std::unordered_map<Var, int>& subs);
+
+/// terms of a univariate polynomial as exponent and coefficient
+typedef std::vector<std::pair<uint32_t, Coeff>> UnivariateTerms;
+
+/// collects the terms of 'p' by descending exponent of 'var' in one
+/// pass, returns false if another variable occurs
+bool univariateTerms(const Polynomial& p, Var var, UnivariateTerms& terms);
+
+/// sets values[i] to the value of 'terms' at points[i] by Horner's rule,
+/// evaluating at all points in one pass over the terms
+void evaluateUnivariate(const UnivariateTerms& terms, const std::vector<Coeff>& points,
+                        std::vector<Coeff>& values);
+
+void printPolynomial(const Polynomial& p, std::ostream& out = std::cout);
+
+/// collects the indices of the variables occurring in 'poly'
+std::vector<Var> getVariables(const Polynomial& poly);
+
+/// checks whether all variables of 'poly' are flagged in 'allowed'
+bool allVariablesAllowed(const Polynomial& poly, const std::vector<bool>& allowed);
+
+/*------------------------------------------------------------------------*/
+#endif  // PACHECK2_SRC_POLYNOMIAL_HPP_
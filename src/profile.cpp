@@ -0,0 +1,164 @@
+/*------------------------------------------------------------------------*/
+/*! \file profile.cpp
+    \brief counters and timers of the basic operations and of rules
+
+  Part of Pacheck 3.0 : PAC proof checker.
+*/
+/*------------------------------------------------------------------------*/
+#include "profile.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <mutex>
+#ifdef HAVEGETRUSAGE
+#include <sys/resource.h>
+#endif
+/*------------------------------------------------------------------------*/
+// may be enabled while other proofs are checked
+static std::atomic<bool> profiling{false};
+/*------------------------------------------------------------------------*/
+
+const char* operationName(Operation op) {
+  switch (op) {
+    case Operation::Tokenize: return "tokenize";
+    case Operation::Parse: return "parse";
+    case Operation::Multiply: return "multiply";
+    case Operation::Add: return "add";
+    case Operation::Substitute: return "substitute";
+    default: return "compare";
+  }
+}
+
+void enableProfiling() { profiling = true; }
+
+bool profilingEnabled() { return profiling.load(std::memory_order_relaxed); }
+
+uint64_t nanoseconds() {
+  return std::chrono::duration_cast<std::chrono::nanoseconds>(
+             std::chrono::steady_clock::now().time_since_epoch())
+      .count();
+}
+
+double secondsSince(uint64_t start) { return (nanoseconds() - start) * 1e-9; }
+/*------------------------------------------------------------------------*/
+// Operations
+
+/// written by its thread only, read when the statistics are printed
+struct ThreadCounters {
+  std::atomic<uint64_t> calls[num_operations] = {};
+  std::atomic<uint64_t> nanos[num_operations] = {};
+  unsigned depth[num_operations] = {};  // nesting of timed scopes
+};
+
+/// counters of the running threads, and the sums of the ended ones,
+/// since checkers start and end threads of their own
+static std::mutex registry_mutex;
+static std::vector<ThreadCounters*> registry;
+static ThreadCounters retired;
+
+static thread_local ThreadCounters* thread_counters = nullptr;
+
+/// retires the counters of its thread when the thread ends
+struct ThreadCountersOwner {
+  ~ThreadCountersOwner() {
+    std::lock_guard<std::mutex> lock(registry_mutex);
+    for (int i = 0; i < num_operations; ++i) {
+      retired.calls[i] += thread_counters->calls[i].load(std::memory_order_relaxed);
+      retired.nanos[i] += thread_counters->nanos[i].load(std::memory_order_relaxed);
+    }
+    registry.erase(std::find(registry.begin(), registry.end(), thread_counters));
+    delete thread_counters;
+    thread_counters = nullptr;
+  }
+};
+
+static ThreadCounters& threadCounters() {
+  if (!thread_counters) {
+    thread_counters = new ThreadCounters;
+    static thread_local ThreadCountersOwner owner;
+    std::lock_guard<std::mutex> lock(registry_mutex);
+    registry.push_back(thread_counters);
+  }
+  return *thread_counters;
+}
+
+/// no other thread writes 'counter', so no atomic read-modify-write
+static void increment(std::atomic<uint64_t>& counter, uint64_t value) {
+  counter.store(counter.load(std::memory_order_relaxed) + value, std::memory_order_relaxed);
+}
+
+OperationScope::OperationScope(Operation op) : op_(op) {
+  ThreadCounters& c = threadCounters();
+  const int i = static_cast<int>(op);
+  increment(c.calls[i], 1);
+  profiled_ = profilingEnabled();
+  if (profiled_ && !c.depth[i]++) start_ = nanoseconds();
+}
+
+OperationScope::~OperationScope() {
+  if (!profiled_) return;
+  ThreadCounters& c = threadCounters();
+  const int i = static_cast<int>(op_);
+  c.depth[i]--;
+  if (start_) increment(c.nanos[i], nanoseconds() - start_);
+}
+
+OperationCounts operationCounts(Operation op) {
+  const int i = static_cast<int>(op);
+  OperationCounts counts{0, 0};
+  std::lock_guard<std::mutex> lock(registry_mutex);
+  counts.calls += retired.calls[i].load(std::memory_order_relaxed);
+  counts.seconds += retired.nanos[i].load(std::memory_order_relaxed) * 1e-9;
+  for (const ThreadCounters* c : registry) {
+    counts.calls += c->calls[i].load(std::memory_order_relaxed);
+    counts.seconds += c->nanos[i].load(std::memory_order_relaxed) * 1e-9;
+  }
+  return counts;
+}
+/*------------------------------------------------------------------------*/
+// Rules
+
+static bool faster(const RuleTime& a, const RuleTime& b) { return a.seconds > b.seconds; }
+
+SlowestRules::SlowestRules(size_t n) : size_(n) {
+  if (n) profiling = true;
+}
+
+void SlowestRules::record(int lineno, const char* kind, double seconds) {
+  if (!size_) return;
+  if (heap_.size() == size_) {
+    if (seconds <= heap_.front().seconds) return;
+    std::pop_heap(heap_.begin(), heap_.end(), faster);
+    heap_.pop_back();
+  }
+  heap_.push_back({lineno, kind, seconds});
+  std::push_heap(heap_.begin(), heap_.end(), faster);
+}
+
+std::vector<RuleTime> SlowestRules::rules() const {
+  std::vector<RuleTime> rules = heap_;
+  std::sort(rules.begin(), rules.end(), faster);
+  return rules;
+}
+/*------------------------------------------------------------------------*/
+// Resources
+
+long peakResidentSetSize() {
+#ifdef HAVEGETRUSAGE
+  struct rusage usage;
+  if (!getrusage(RUSAGE_SELF, &usage)) return usage.ru_maxrss;
+#endif
+  return 0;
+}
+
+double processSeconds() {
+#ifdef HAVEGETRUSAGE
+  struct rusage usage;
+  if (!getrusage(RUSAGE_SELF, &usage)) {
+    return usage.ru_utime.tv_sec + 1e-6 * usage.ru_utime.tv_usec + usage.ru_stime.tv_sec +
+           1e-6 * usage.ru_stime.tv_usec;
+  }
+#endif
+  return 0;
+}
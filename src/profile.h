@@ -0,0 +1,94 @@
+/*------------------------------------------------------------------------*/
+/*! \file profile.h
+    \brief counters and timers of the basic operations and of rules
+
+  Every thread counts the calls of the basic operations in counters of
+  its own, which only it writes, so counting costs an increment. With
+  profiling enabled the calls are also timed, where nested calls of the
+  same operation, e.g. the multiplications within a parsed product, are
+  timed by the outermost one, and the slowest rules are kept. Times of
+  different operations overlap, e.g. parsing includes tokenizing. The
+  counters are summed over all proofs checked by the process, while
+  every checker keeps the slowest rules of its proof.
+
+  Part of Pacheck 3.0 : PAC proof checker.
+*/
+/*------------------------------------------------------------------------*/
+#ifndef PACHECK2_SRC_PROFILE_H_
+#define PACHECK2_SRC_PROFILE_H_
+/*------------------------------------------------------------------------*/
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+/*------------------------------------------------------------------------*/
+
+enum class Operation { Tokenize, Parse, Multiply, Add, Substitute, Compare };
+const int num_operations = 6;
+
+const char* operationName(Operation op);
+
+/// times operations and rules from now on
+void enableProfiling();
+bool profilingEnabled();
+
+/// counts a call of 'op' and times it if profiling is enabled
+class OperationScope {
+ public:
+  explicit OperationScope(Operation op);
+  OperationScope(const OperationScope&) = delete;
+  OperationScope& operator=(const OperationScope&) = delete;
+  ~OperationScope();
+
+ private:
+  Operation op_;
+  bool profiled_;       // profiling was enabled on entry
+  uint64_t start_ = 0;  // in nanoseconds, 0 if not timed
+};
+
+struct OperationCounts {
+  uint64_t calls;
+  double seconds;
+};
+
+/// summed over all threads
+OperationCounts operationCounts(Operation op);
+/*------------------------------------------------------------------------*/
+
+struct RuleTime {
+  int lineno;
+  const char* kind;
+  double seconds;
+};
+
+/// the slowest rules of a proof
+class SlowestRules {
+ public:
+  /// keeps the 'n' slowest rules, which enables profiling if 'n' > 0
+  explicit SlowestRules(size_t n = 0);
+
+  /// records the time of a rule, if keeping any
+  void record(int lineno, const char* kind, double seconds);
+
+  /// the slowest rules, slowest first
+  std::vector<RuleTime> rules() const;
+
+ private:
+  size_t size_;
+  std::vector<RuleTime> heap_;  // min-heap of the slowest rules
+};
+/*------------------------------------------------------------------------*/
+
+/// seconds since 'start', a value of nanoseconds()
+double secondsSince(uint64_t start);
+
+/// monotonic clock
+uint64_t nanoseconds();
+
+/// peak resident set size in KB, 0 if unknown
+long peakResidentSetSize();
+
+/// user and system time of the process, 0 if unknown
+double processSeconds();
+
+/*------------------------------------------------------------------------*/
+#endif  // PACHECK2_SRC_PROFILE_H_
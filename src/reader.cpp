@@ -0,0 +1,355 @@
+/*------------------------------------------------------------------------*/
+/*! \file reader.cpp
+    \brief zero-copy line reader for proof files
+
+  Part of Pacheck 3.0 : PAC proof checker.
+*/
+/*------------------------------------------------------------------------*/
+#include "reader.h"
+
+#include <cerrno>
+#include <cstring>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#ifdef HAVEZLIB
+#include <zlib.h>
+#endif
+#ifdef HAVELZMA
+#include <lzma.h>
+#endif
+/*------------------------------------------------------------------------*/
+static const size_t chunk_size = 4 << 20;  // bytes per chunk
+static const size_t num_chunks = 4;        // chunks in flight
+/*------------------------------------------------------------------------*/
+// Byte sources
+
+/// reads a file descriptor, starting with the bytes already peeked at
+class FileSource : public ByteSource {
+ public:
+  FileSource(int fd, std::string prefix) : fd_(fd), prefix_(std::move(prefix)) {}
+  ~FileSource() { if (fd_ > 0) close(fd_); }
+
+  long read(char* buffer, size_t size) override {
+    if (pos_ < prefix_.size()) {
+      size_t n = std::min(size, prefix_.size() - pos_);
+      memcpy(buffer, prefix_.data() + pos_, n);
+      pos_ += n;
+      return n;
+    }
+    while (true) {
+      ssize_t n = ::read(fd_, buffer, size);
+      if (n >= 0 || errno != EINTR) return n;
+    }
+  }
+
+  std::string error() const override { return strerror(errno); }
+
+ private:
+  int fd_;
+  std::string prefix_;
+  size_t pos_ = 0;
+};
+
+#ifdef HAVEZLIB
+/// inflates gzip streams, including concatenated members
+class GzipSource : public ByteSource {
+ public:
+  explicit GzipSource(std::unique_ptr<ByteSource> in) : in_(std::move(in)), buffer_(1 << 16) {
+    memset(&zs_, 0, sizeof zs_);
+    ok_ = inflateInit2(&zs_, 16 + MAX_WBITS) == Z_OK;
+  }
+  ~GzipSource() { inflateEnd(&zs_); }
+
+  long read(char* buffer, size_t size) override {
+    if (!ok_) return -1;
+    zs_.next_out = reinterpret_cast<Bytef*>(buffer);
+    zs_.avail_out = static_cast<uInt>(size);
+    while (zs_.avail_out == size) {
+      if (zs_.avail_in == 0) {
+        long n = in_->read(buffer_.data(), buffer_.size());
+        if (n < 0) return fail("read error: " + in_->error());
+        if (n == 0) {
+          if (!finished_) return fail("unexpected end of gzip stream");
+          return 0;
+        }
+        zs_.next_in = reinterpret_cast<Bytef*>(buffer_.data());
+        zs_.avail_in = static_cast<uInt>(n);
+      }
+      int res = inflate(&zs_, Z_NO_FLUSH);
+      finished_ = false;
+      if (res == Z_STREAM_END) {
+        finished_ = true;
+        inflateReset(&zs_);
+      } else if (res != Z_OK && res != Z_BUF_ERROR) {
+        return fail(zs_.msg ? zs_.msg : "corrupt gzip stream");
+      }
+    }
+    return size - zs_.avail_out;
+  }
+
+  std::string error() const override { return error_; }
+
+ private:
+  long fail(const std::string& msg) {
+    error_ = msg;
+    ok_ = false;
+    return -1;
+  }
+
+  std::unique_ptr<ByteSource> in_;
+  std::vector<char> buffer_;
+  z_stream zs_;
+  bool ok_;
+  bool finished_ = false;
+  std::string error_;
+};
+#endif
+
+#ifdef HAVELZMA
+/// decodes xz streams, including concatenated ones
+class XzSource : public ByteSource {
+ public:
+  explicit XzSource(std::unique_ptr<ByteSource> in) : in_(std::move(in)), buffer_(1 << 16) {
+    ok_ = lzma_stream_decoder(&ls_, UINT64_MAX, LZMA_CONCATENATED) == LZMA_OK;
+  }
+  ~XzSource() { lzma_end(&ls_); }
+
+  long read(char* buffer, size_t size) override {
+    if (!ok_) return -1;
+    ls_.next_out = reinterpret_cast<uint8_t*>(buffer);
+    ls_.avail_out = size;
+    while (ls_.avail_out == size && !done_) {
+      if (ls_.avail_in == 0 && !input_done_) {
+        long n = in_->read(buffer_.data(), buffer_.size());
+        if (n < 0) return fail("read error: " + in_->error());
+        input_done_ = n == 0;
+        ls_.next_in = reinterpret_cast<uint8_t*>(buffer_.data());
+        ls_.avail_in = n;
+      }
+      lzma_ret res = lzma_code(&ls_, input_done_ ? LZMA_FINISH : LZMA_RUN);
+      if (res == LZMA_STREAM_END) done_ = true;
+      else if (res != LZMA_OK) return fail("corrupt xz stream");
+    }
+    return size - ls_.avail_out;
+  }
+
+  std::string error() const override { return error_; }
+
+ private:
+  long fail(const std::string& msg) {
+    error_ = msg;
+    ok_ = false;
+    return -1;
+  }
+
+  std::unique_ptr<ByteSource> in_;
+  std::vector<char> buffer_;
+  lzma_stream ls_ = LZMA_STREAM_INIT;
+  bool ok_;
+  bool input_done_ = false;
+  bool done_ = false;
+  std::string error_;
+};
+#endif
+/*------------------------------------------------------------------------*/
+
+ProofReader::~ProofReader() {
+  if (thread_.joinable()) {
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      stop_ = true;
+    }
+    cond_.notify_all();
+    thread_.join();
+  }
+  if (map_) munmap(const_cast<char*>(map_), map_size_);
+}
+
+bool ProofReader::open(const std::string& path) {
+  int fd = path == "-" ? 0 : ::open(path.c_str(), O_RDONLY);
+  if (fd < 0) {
+    error_ = strerror(errno);
+    return false;
+  }
+
+  // peek at the magic bytes, keeping them for non-seekable input
+  char magic[6];
+  ssize_t n = 0;
+  while (n < 6) {
+    ssize_t r = ::read(fd, magic + n, 6 - n);
+    if (r < 0 && errno == EINTR) continue;
+    if (r <= 0) break;
+    n += r;
+  }
+  bool gzip = n >= 2 && !memcmp(magic, "\x1f\x8b", 2);
+  bool xz = n >= 6 && !memcmp(magic, "\xfd" "7zXZ\0", 6);
+
+  struct stat st;
+  if (!gzip && !xz && fstat(fd, &st) == 0 && S_ISREG(st.st_mode)) {
+    map_size_ = st.st_size;
+    if (map_size_ > 0) {
+      void* map = mmap(nullptr, map_size_, PROT_READ, MAP_PRIVATE, fd, 0);
+      if (map != MAP_FAILED) {
+        madvise(map, map_size_, MADV_SEQUENTIAL);
+        map_ = static_cast<const char*>(map);
+      }
+    }
+    if (map_ || map_size_ == 0) {
+      close(fd);
+      pos_ = map_;
+      end_ = map_ + map_size_;
+      return true;
+    }
+  }
+
+  std::unique_ptr<ByteSource> source(new FileSource(fd, std::string(magic, n > 0 ? n : 0)));
+  if (gzip) {
+#ifdef HAVEZLIB
+    source.reset(new GzipSource(std::move(source)));
+#else
+    error_ = "gzip compressed proofs are not supported by this build";
+    return false;
+#endif
+  } else if (xz) {
+#ifdef HAVELZMA
+    source.reset(new XzSource(std::move(source)));
+#else
+    error_ = "xz compressed proofs are not supported by this build";
+    return false;
+#endif
+  }
+  startReaderThread(std::move(source));
+  return true;
+}
+/*------------------------------------------------------------------------*/
+
+void ProofReader::startReaderThread(std::unique_ptr<ByteSource> source) {
+  source_ = std::move(source);
+  for (size_t i = 0; i < num_chunks; ++i) {
+    chunks_.emplace_back(new Chunk);
+    chunks_.back()->data.resize(chunk_size);
+    free_.push_back(chunks_.back().get());
+  }
+  thread_ = std::thread(&ProofReader::readerLoop, this);
+}
+
+void ProofReader::readerLoop() {
+  while (true) {
+    Chunk* chunk;
+    {
+      std::unique_lock<std::mutex> lock(mutex_);
+      cond_.wait(lock, [this] { return stop_ || !free_.empty(); });
+      if (stop_) return;
+      chunk = free_.back();
+      free_.pop_back();
+    }
+
+    size_t n = 0;
+    bool eof = false, failed = false;
+    while (n < chunk->data.size()) {
+      long r = source_->read(chunk->data.data() + n, chunk->data.size() - n);
+      if (r < 0) failed = true;
+      if (r <= 0) {
+        eof = true;
+        break;
+      }
+      n += r;
+    }
+    chunk->size = n;
+
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      if (n) filled_.push_back(chunk);
+      else free_.push_back(chunk);
+      if (failed) error_ = source_->error();
+      if (eof) source_done_ = true;
+    }
+    cond_.notify_all();
+    if (eof) return;
+  }
+}
+
+/// moves to the next chunk filled by the reader thread
+bool ProofReader::nextChunk() {
+  if (!thread_.joinable()) return false;
+
+  std::unique_lock<std::mutex> lock(mutex_);
+  if (current_) {
+    free_.push_back(current_);
+    current_ = nullptr;
+    cond_.notify_all();
+  }
+  cond_.wait(lock, [this] { return source_done_ || !filled_.empty(); });
+  if (filled_.empty()) return false;
+
+  current_ = filled_.front();
+  filled_.pop_front();
+  pos_ = current_->data.data();
+  end_ = pos_ + current_->size;
+  return true;
+}
+
+bool ProofReader::startsWith(std::string_view prefix) {
+  if (pos_ == end_ && !nextChunk()) return prefix.empty();
+  return size_t(end_ - pos_) >= prefix.size() && !memcmp(pos_, prefix.data(), prefix.size());
+}
+
+bool ProofReader::nextBlock(const char*& data, size_t& size) {
+  if (pos_ == end_ && !nextChunk()) return false;
+  data = pos_;
+  size = end_ - pos_;
+  bytes_read_ += size;
+  pos_ = end_;
+  return true;
+}
+
+bool ProofReader::skipTo(size_t offset) {
+  if (map_ && carry_.empty() && bytes_read_ <= offset && offset <= map_size_) {
+    if (offset > 0 && offset < map_size_ && map_[offset - 1] != '\n') return false;
+    pos_ = map_ + offset;
+    bytes_read_ = offset;
+    return true;
+  }
+  std::string_view line;
+  while (bytes_read_ < offset && nextLine(line)) {}
+  return bytes_read_ == offset;
+}
+
+bool ProofReader::nextLine(std::string_view& line) {
+  if (carry_returned_) {
+    carry_.clear();
+    carry_returned_ = false;
+  }
+
+  while (true) {
+    if (pos_ < end_) {
+      const char* nl = static_cast<const char*>(memchr(pos_, '\n', end_ - pos_));
+      if (nl) {
+        bytes_read_ += nl + 1 - pos_;
+        if (carry_.empty()) {
+          line = std::string_view(pos_, nl - pos_);
+        } else {
+          carry_.append(pos_, nl - pos_);
+          line = carry_;
+          carry_returned_ = true;
+        }
+        pos_ = nl + 1;
+        return true;
+      }
+      bytes_read_ += end_ - pos_;
+      carry_.append(pos_, end_ - pos_);
+      pos_ = end_;
+    }
+
+    if (!nextChunk()) {
+      // a partial line of a corrupt stream is not handed out
+      if (carry_.empty() || !error_.empty()) return false;
+      // last line without line break
+      line = carry_;
+      carry_returned_ = true;
+      return true;
+    }
+  }
+}
@@ -0,0 +1,109 @@
+/*------------------------------------------------------------------------*/
+/*! \file reader.h
+    \brief zero-copy line reader for proof files
+
+  Regular uncompressed files are memory mapped and lines are handed out
+  as views into the mapping. Pipes and compressed proofs (gzip and xz,
+  recognized by their magic bytes) are read in large chunks by a
+  background thread, which decompresses ahead of the checker. Only lines
+  straddling two chunks are copied.
+
+  Part of Pacheck 3.0 : PAC proof checker.
+*/
+/*------------------------------------------------------------------------*/
+#ifndef PACHECK2_SRC_READER_H_
+#define PACHECK2_SRC_READER_H_
+/*------------------------------------------------------------------------*/
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+/*------------------------------------------------------------------------*/
+
+/// source of (decompressed) bytes used by the background reader
+class ByteSource {
+ public:
+  virtual ~ByteSource() {}
+  /// reads up to 'size' bytes, returns 0 at the end and -1 on errors
+  virtual long read(char* buffer, size_t size) = 0;
+  /// describes the last error
+  virtual std::string error() const = 0;
+};
+
+class ProofReader {
+ public:
+  ProofReader() {}
+  ~ProofReader();
+  ProofReader(const ProofReader&) = delete;
+  ProofReader& operator=(const ProofReader&) = delete;
+
+  /// opens 'path' ("-" for standard input), returns false on failure
+  bool open(const std::string& path);
+
+  /// sets 'line' to the next line without its line break, which stays
+  /// valid until the next call, returns false at the end of the input
+  bool nextLine(std::string_view& line);
+
+  /// whether the (decompressed) input starts with 'prefix', which does
+  /// not consume anything
+  bool startsWith(std::string_view prefix);
+
+  /// sets 'data' to the next block of raw input, which stays valid until
+  /// the next call, returns false at the end of the input, not to be
+  /// mixed with nextLine
+  bool nextBlock(const char*& data, size_t& size);
+
+  /// skips the input up to byte 'offset', which has to end a line,
+  /// directly if it is memory mapped and line by line otherwise, returns
+  /// false if it does not end a line or the input ends before
+  bool skipTo(size_t offset);
+
+  /// number of (decompressed) bytes handed out so far
+  size_t bytesRead() const { return bytes_read_; }
+
+  /// non-empty if opening or reading failed
+  const std::string& error() const { return error_; }
+
+ private:
+  struct Chunk {
+    std::vector<char> data;
+    size_t size = 0;
+  };
+
+  void startReaderThread(std::unique_ptr<ByteSource> source);
+  void readerLoop();
+  bool nextChunk();
+
+  std::string error_;
+  size_t bytes_read_ = 0;
+
+  // memory mapped input
+  const char* map_ = nullptr;
+  size_t map_size_ = 0;
+
+  // current block of input, either the mapping or a chunk
+  const char* pos_ = nullptr;
+  const char* end_ = nullptr;
+  std::string carry_;  // line straddling two chunks
+  bool carry_returned_ = false;
+
+  // chunks filled by the background thread
+  std::unique_ptr<ByteSource> source_;
+  std::thread thread_;
+  std::mutex mutex_;
+  std::condition_variable cond_;
+  std::vector<Chunk*> free_;
+  std::deque<Chunk*> filled_;
+  std::vector<std::unique_ptr<Chunk>> chunks_;
+  Chunk* current_ = nullptr;
+  bool source_done_ = false;
+  bool stop_ = false;
+};
+
+/*------------------------------------------------------------------------*/
+#endif  // PACHECK2_SRC_READER_H_
@@ -0,0 +1,134 @@
+/*------------------------------------------------------------------------*/
+/*! \file spill.cpp
+    \brief on-disk store of polynomials evicted under memory pressure
+
+  Part of Pacheck 3.0 : PAC proof checker.
+*/
+/*------------------------------------------------------------------------*/
+#include "spill.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <unistd.h>
+/*------------------------------------------------------------------------*/
+
+void putVarint(std::vector<uint8_t>& buffer, uint64_t value) {
+  while (value >= 128) {
+    buffer.push_back(static_cast<uint8_t>(value | 128));
+    value >>= 7;
+  }
+  buffer.push_back(static_cast<uint8_t>(value));
+}
+
+bool getVarint(const uint8_t*& pos, const uint8_t* end, uint64_t& value) {
+  value = 0;
+  for (unsigned shift = 0; pos != end && shift < 64; shift += 7) {
+    const uint8_t b = *pos++;
+    value |= uint64_t(b & 127) << shift;
+    if (!(b & 128)) return true;
+  }
+  return false;
+}
+
+void encodePolynomial(const Polynomial& poly, std::vector<uint8_t>& buffer) {
+  std::vector<uint8_t> digits;
+  putVarint(buffer, poly.size());
+  for (const auto& [mono, coeff] : poly) {
+    const bool negative = isNegativeCoeff(coeff);
+    putVarint(buffer, uint64_t(mono.size()) << 1 | negative);
+    digits.clear();
+    coeffToBase128(negative ? negCoeff(coeff) : coeff, digits);
+    for (size_t i = 0; i + 1 < digits.size(); ++i) buffer.push_back(digits[i] | 128);
+    buffer.push_back(digits.back());
+    for (const auto& [var, exp] : mono) {
+      putVarint(buffer, var);
+      putVarint(buffer, exp);
+    }
+  }
+}
+
+bool decodePolynomial(const uint8_t*& pos, const uint8_t* end, Polynomial& poly,
+                      const std::vector<Var>* vars) {
+  std::vector<uint8_t> digits;
+  std::vector<VarPower> factors;
+  uint64_t size, head, var, exp;
+  if (!getVarint(pos, end, size)) return false;
+  TermVector terms;
+  terms.reserve(std::min<uint64_t>(size, end - pos));  // bounded for corrupted input
+  for (uint64_t i = 0; i < size; ++i) {
+    if (!getVarint(pos, end, head)) return false;
+    digits.clear();
+    do {
+      if (pos == end) return false;
+      digits.push_back(*pos & 127);
+    } while (*pos++ & 128);
+    const Coeff c = coeffFromBase128(digits.data(), digits.size());
+    factors.clear();
+    for (uint64_t k = 0; k < head >> 1; ++k) {
+      if (!getVarint(pos, end, var) || !getVarint(pos, end, exp)) return false;
+      if (vars) {
+        if (var >= vars->size()) return false;
+        var = (*vars)[var];
+      }
+      factors.push_back({static_cast<Var>(var), static_cast<uint32_t>(exp)});
+    }
+    // remapped variables may be interned in another order
+    if (vars) {
+      std::sort(factors.begin(), factors.end(),
+                [](const VarPower& a, const VarPower& b) { return a.var < b.var; });
+    }
+    terms.push_back({Monomial(factors.data(), factors.size()), head & 1 ? negCoeff(c) : c});
+  }
+  poly = Polynomial(std::move(terms));
+  return true;
+}
+/*------------------------------------------------------------------------*/
+
+SpillFile::~SpillFile() {
+  if (file_) fclose(file_);
+}
+
+bool SpillFile::fail() {
+  if (error_.empty()) error_ = errno ? strerror(errno) : "corrupted spill file";
+  return false;
+}
+
+bool SpillFile::write(const Polynomial& poly, SpillSlot& slot) {
+  if (!error_.empty()) return false;
+  if (!file_ && !(file_ = tmpfile())) return fail();
+
+  buffer_.clear();
+  encodePolynomial(poly, buffer_);
+
+  errno = 0;
+  if (pwrite(fileno(file_), buffer_.data(), buffer_.size(), size_) !=
+      static_cast<ssize_t>(buffer_.size())) {
+    return fail();
+  }
+  slot = {size_, buffer_.size()};
+  size_ += buffer_.size();
+  return true;
+}
+
+bool SpillFile::read(const SpillSlot& slot, Polynomial& poly) {
+  if (!error_.empty()) return false;
+  buffer_.resize(slot.bytes);
+  errno = 0;
+  if (pread(fileno(file_), buffer_.data(), slot.bytes, slot.offset) !=
+      static_cast<ssize_t>(slot.bytes)) {
+    return fail();
+  }
+
+  const uint8_t* pos = buffer_.data();
+  if (!decodePolynomial(pos, pos + buffer_.size(), poly)) return fail();
+  return true;
+}
+
+bool SpillFile::readBytes(const SpillSlot& slot, std::vector<uint8_t>& bytes) const {
+  if (!file_) return false;
+  const size_t old_size = bytes.size();
+  bytes.resize(old_size + slot.bytes);
+  return pread(fileno(file_), bytes.data() + old_size, slot.bytes, slot.offset)
+         == static_cast<ssize_t>(slot.bytes);
+}
@@ -0,0 +1,80 @@
+/*------------------------------------------------------------------------*/
+/*! \file spill.h
+    \brief on-disk store of polynomials evicted under memory pressure
+
+  With a memory limit, the checker moves cold polynomials out of memory
+  into an unlinked temporary file and reloads them when a later rule uses
+  them. Polynomials are encoded like in binary proofs (see binary.h), but
+  with variables given by their interned index, and the file only grows:
+  space of reloaded or deleted polynomials is reclaimed at exit.
+
+  Part of Pacheck 3.0 : PAC proof checker.
+*/
+/*------------------------------------------------------------------------*/
+#ifndef PACHECK2_SRC_SPILL_H_
+#define PACHECK2_SRC_SPILL_H_
+/*------------------------------------------------------------------------*/
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <string>
+#include <vector>
+#include "polynomial.hpp"
+/*------------------------------------------------------------------------*/
+
+/// appends the LEB128 encoding of 'value'
+void putVarint(std::vector<uint8_t>& buffer, uint64_t value);
+
+/// decodes a varint from [pos, end), returns false if it is truncated
+bool getVarint(const uint8_t*& pos, const uint8_t* end, uint64_t& value);
+
+/// appends the encoding of 'poly' used by spill files and checkpoints
+void encodePolynomial(const Polynomial& poly, std::vector<uint8_t>& buffer);
+
+/// decodes a polynomial from [pos, end) within the current scope,
+/// mapping each variable index i to (*vars)[i] if 'vars' is given,
+/// returns false if the encoding is corrupted
+bool decodePolynomial(const uint8_t*& pos, const uint8_t* end, Polynomial& poly,
+                      const std::vector<Var>* vars = nullptr);
+
+/// where a spilled polynomial was written
+struct SpillSlot {
+  uint64_t offset;
+  uint64_t bytes;
+};
+
+class SpillFile {
+ public:
+  SpillFile() {}
+  ~SpillFile();
+  SpillFile(const SpillFile&) = delete;
+  SpillFile& operator=(const SpillFile&) = delete;
+
+  /// appends 'poly', creating the file on first use, returns false on
+  /// failure, see error()
+  bool write(const Polynomial& poly, SpillSlot& slot);
+
+  /// reads back a polynomial, allocating within the current scope,
+  /// returns false on failure
+  bool read(const SpillSlot& slot, Polynomial& poly);
+
+  /// appends the encoding of a spilled polynomial to 'bytes', without
+  /// recording errors, so other threads may call it while the file grows
+  bool readBytes(const SpillSlot& slot, std::vector<uint8_t>& bytes) const;
+
+  size_t bytesWritten() const { return size_; }
+
+  /// non-empty if writing or reading failed
+  const std::string& error() const { return error_; }
+
+ private:
+  bool fail();
+
+  FILE* file_ = nullptr;
+  uint64_t size_ = 0;
+  std::vector<uint8_t> buffer_;
+  std::string error_;
+};
+
+/*------------------------------------------------------------------------*/
+#endif  // PACHECK2_SRC_SPILL_H_
@@ -0,0 +1,124 @@
+/*------------------------------------------------------------------------*/
+/*! \file store.cpp
+    \brief hash-consed store of immutable polynomials
+
+  Part of Pacheck 3.0 : PAC proof checker.
+*/
+/*------------------------------------------------------------------------*/
+#include "store.h"
+#include "memory.h"
+
+#include <algorithm>
+#include <atomic>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+/*------------------------------------------------------------------------*/
+
+/// the table holds weak handles only, a polynomial removes its own entry
+/// when it is freed, which may happen on any thread
+struct PolynomialTable {
+  struct Entry {
+    const Polynomial* poly;  // identifies the entry once 'ref' expired
+    std::weak_ptr<const Polynomial> ref;
+  };
+
+  std::mutex mutex;
+  std::unordered_multimap<uint64_t, Entry> entries;
+  size_t stored = 0;
+  size_t shared = 0;
+  size_t peak = 0;
+  size_t terms = 0;
+  size_t max_degree = 0;
+  std::atomic<size_t> bytes{0};  // of the polynomials alive
+};
+
+/// never destroyed, since handles may still be released during exit
+static PolynomialTable& polynomialTable() {
+  static PolynomialTable* table = new PolynomialTable;
+  return *table;
+}
+
+/// the fingerprint already sums up all terms
+static uint64_t hashPolynomial(const Polynomial& poly) {
+  uint64_t h = poly.size();
+  if (fingerprintsEnabled()) return (h ^ hashCoeff(poly.fingerprint())) * 0x9E3779B97F4A7C15ull;
+  for (const auto& [mono, coeff] : poly) {
+    h = (h ^ mono.hash()) * 0x9E3779B97F4A7C15ull;
+    h = (h ^ hashCoeff(coeff)) * 0xC2B2AE3D27D4EB4Full;
+    h ^= h >> 31;
+  }
+  return h;
+}
+
+/// approximate, interned monomials may be shared with other polynomials
+static size_t polynomialBytes(const Polynomial& poly) {
+  size_t bytes = sizeof(Polynomial) + poly.size() * sizeof(Term);
+  for (const Term& term : poly) bytes += term.mono.size() * sizeof(VarPower);
+  return bytes;
+}
+/*------------------------------------------------------------------------*/
+
+PolynomialRef storePolynomial(Polynomial poly) {
+  PhaseScope phase(Phase::Store);
+  PolynomialTable& table = polynomialTable();
+  const uint64_t hash = hashPolynomial(poly);
+
+  // candidates are compared outside the lock, since dropping the last
+  // handle of one runs its deleter, which takes the lock
+  std::vector<PolynomialRef> candidates;
+  {
+    std::lock_guard<std::mutex> lock(table.mutex);
+    table.stored++;
+    auto [begin, end] = table.entries.equal_range(hash);
+    for (auto it = begin; it != end; ++it) {
+      if (PolynomialRef existing = it->second.ref.lock()) candidates.push_back(std::move(existing));
+    }
+  }
+  for (const PolynomialRef& existing : candidates) {
+    if (*existing == poly) {
+      std::lock_guard<std::mutex> lock(table.mutex);
+      table.shared++;
+      return existing;
+    }
+  }
+
+  poly.makePersistent();
+  const Polynomial* stored = new Polynomial(std::move(poly));
+  const size_t bytes = polynomialBytes(*stored);
+  PolynomialRef ref(stored, [hash, bytes](const Polynomial* p) {
+    PolynomialTable& table = polynomialTable();
+    {
+      std::lock_guard<std::mutex> lock(table.mutex);
+      table.bytes -= bytes;
+      auto [begin, end] = table.entries.equal_range(hash);
+      for (auto it = begin; it != end; ++it) {
+        if (it->second.poly == p) {
+          table.entries.erase(it);
+          break;
+        }
+      }
+    }
+    delete p;
+  });
+
+  // terms are ordered by degree first
+  const size_t degree = stored->empty() ? 0 : (*stored)[0].mono.degree();
+  std::lock_guard<std::mutex> lock(table.mutex);
+  table.entries.emplace(hash, PolynomialTable::Entry{stored, ref});
+  table.peak = std::max(table.peak, table.entries.size());
+  table.terms += stored->size();
+  table.bytes += bytes;
+  table.max_degree = std::max(table.max_degree, degree);
+  return ref;
+}
+
+size_t storedBytes() { return polynomialTable().bytes.load(std::memory_order_relaxed); }
+
+StoreStatistics storeStatistics() {
+  PolynomialTable& table = polynomialTable();
+  std::lock_guard<std::mutex> lock(table.mutex);
+  return {table.stored,         table.shared, table.entries.size(),
+          table.peak,           Monomial::numInterned(), Monomial::peakInterned(),
+          table.terms,          table.max_degree};
+}
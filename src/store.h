@@ -0,0 +1,46 @@
+/*------------------------------------------------------------------------*/
+/*! \file store.h
+    \brief hash-consed store of immutable polynomials
+
+  Polynomials bound to IDs are kept in the store. Identical polynomials
+  are shared through one reference counted handle and the monomials of
+  stored polynomials are interned, so re-derived polynomials and
+  near-duplicates cost little memory. A polynomial leaves the store and
+  is freed as soon as its last handle goes, e.g. on its 'd' rule. Stored
+  polynomials live on the heap, apart from the scratch arenas of rules.
+
+  Part of Pacheck 3.0 : PAC proof checker.
+*/
+/*------------------------------------------------------------------------*/
+#ifndef PACHECK2_SRC_STORE_H_
+#define PACHECK2_SRC_STORE_H_
+/*------------------------------------------------------------------------*/
+#include <cstddef>
+#include <memory>
+#include "polynomial.hpp"
+/*------------------------------------------------------------------------*/
+/// handle of a stored polynomial, shared with pending checks
+typedef std::shared_ptr<const Polynomial> PolynomialRef;
+
+/// returns the handle of the stored polynomial equal to 'poly',
+/// adding 'poly' if there is none
+PolynomialRef storePolynomial(Polynomial poly);
+
+struct StoreStatistics {
+  size_t stored;          // calls of storePolynomial
+  size_t shared;          // of which returned an existing polynomial
+  size_t alive;           // distinct polynomials currently stored
+  size_t peak;            // maximum of 'alive'
+  size_t monomials;       // distinct interned monomials currently alive
+  size_t monomials_peak;  // maximum of 'monomials'
+  size_t terms;           // of all distinct polynomials added
+  size_t max_degree;      // of all polynomials added
+};
+
+StoreStatistics storeStatistics();
+
+/// approximate memory of the stored polynomials in bytes
+size_t storedBytes();
+
+/*------------------------------------------------------------------------*/
+#endif  // PACHECK2_SRC_STORE_H_
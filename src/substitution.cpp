@@ -0,0 +1,77 @@
+/*------------------------------------------------------------------------*/
+/*! \file substitution.cpp
+    \brief substitutions of open branches with cached substituted forms
+
+  Part of Pacheck 3.0 : PAC proof checker.
+*/
+/*------------------------------------------------------------------------*/
+#include "substitution.h"
+/*------------------------------------------------------------------------*/
+
+std::atomic<size_t> SubstitutionLevel::hits_{0};
+std::atomic<size_t> SubstitutionLevel::misses_{0};
+
+SubstitutionLevel::SubstitutionLevel(Substitution subs) : subs_(std::move(subs)) {}
+
+SubstitutionLevel::SubstitutionLevel(std::shared_ptr<SubstitutionLevel> parent, Var var,
+                                     int value)
+    : subs_(parent->subs_), parent_(std::move(parent)), var_(var), value_(value) {
+  subs_[var] = value;
+}
+
+/// whether 'poly' contains a variable substituted by 'subs'
+static bool mentions(const Polynomial& poly, const Substitution& subs) {
+  for (const auto& [mono, coeff] : poly) {
+    for (const auto& [var, exp] : mono) {
+      if (subs.count(var)) return true;
+    }
+  }
+  return false;
+}
+
+PolynomialRef SubstitutionLevel::lookup(const PolynomialRef& poly) {
+  if (subs_.empty()) return poly;
+  std::lock_guard<std::mutex> lock(mutex_);
+  auto it = cache_.find(poly.get());
+  if (it == cache_.end() || it->second.poly.lock() != poly) return nullptr;
+  hits_.fetch_add(1, std::memory_order_relaxed);
+  return it->second.reduced;
+}
+
+PolynomialRef SubstitutionLevel::reduce(const PolynomialRef& poly, bool via_parents) {
+  if (PolynomialRef cached = lookup(poly)) return cached;
+  misses_.fetch_add(1, std::memory_order_relaxed);
+
+  // computed outside the lock, racing threads compute equal forms
+  PolynomialRef source = poly;
+  const Substitution* added = &subs_;
+  Substitution single;
+  if (parent_) {
+    source = via_parents ? parent_->reduce(poly) : parent_->lookup(poly);
+    if (source) {
+      single[var_] = value_;
+      added = &single;
+    } else {
+      source = poly;
+    }
+  }
+  PolynomialRef reduced = source;
+  if (mentions(*source, *added)) {
+    Polynomial p = substitute(*source, *added);
+    p.makePersistent();
+    reduced = std::make_shared<const Polynomial>(std::move(p));
+  }
+
+  std::lock_guard<std::mutex> lock(mutex_);
+  cache_[poly.get()] = Entry{poly, reduced};
+  return reduced;
+}
+
+void SubstitutionLevel::forget(const Polynomial* poly) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  cache_.erase(poly);
+}
+
+size_t SubstitutionLevel::hits() { return hits_; }
+
+size_t SubstitutionLevel::misses() { return misses_; }
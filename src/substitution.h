@@ -0,0 +1,85 @@
+/*------------------------------------------------------------------------*/
+/*! \file substitution.h
+    \brief substitutions of open branches with cached substituted forms
+
+  Every open branch level has its own SubstitutionLevel, which caches the
+  substituted (reduced) forms of the stored polynomials used under it. A
+  level extending its parent by one variable reduces the parent's cached
+  form in that variable only, instead of substituting from scratch, and
+  closing a branch simply drops its level, so the caches of the outer
+  levels stay valid.
+
+  Part of Pacheck 3.0 : PAC proof checker.
+*/
+/*------------------------------------------------------------------------*/
+#ifndef PACHECK2_SRC_SUBSTITUTION_H_
+#define PACHECK2_SRC_SUBSTITUTION_H_
+/*------------------------------------------------------------------------*/
+#include <atomic>
+#include <cstddef>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+#include "polynomial.hpp"
+#include "store.h"
+/*------------------------------------------------------------------------*/
+
+typedef std::unordered_map<Var, int> Substitution;
+
+/// a substitution together with the reduced forms of stored polynomials,
+/// shared with the pending checks parsed under it
+class SubstitutionLevel {
+ public:
+  /// the empty substitution
+  SubstitutionLevel() = default;
+  /// substitutes 'subs' from scratch
+  explicit SubstitutionLevel(Substitution subs);
+  /// extends 'parent' by 'var' = 'value', where 'var' is not substituted
+  /// by 'parent'
+  SubstitutionLevel(std::shared_ptr<SubstitutionLevel> parent, Var var, int value);
+
+  SubstitutionLevel(const SubstitutionLevel&) = delete;
+  SubstitutionLevel& operator=(const SubstitutionLevel&) = delete;
+
+  const Substitution& substitution() const { return subs_; }
+  bool empty() const { return subs_.empty(); }
+
+  /// the substituted form of a stored polynomial, cached until 'forget'
+  /// or until the level is dropped, may be called from any thread,
+  /// 'via_parents' also caches it in the outer levels, which pays off
+  /// for antecedents used again in sibling branches
+  PolynomialRef reduce(const PolynomialRef& poly, bool via_parents = true);
+
+  /// the substituted form of a temporary polynomial
+  Polynomial reduce(const Polynomial& poly) const { return substitute(poly, subs_); }
+
+  /// drops the cached form of 'poly', e.g. on its 'd' rule
+  void forget(const Polynomial* poly);
+
+  /// number of cached forms reused and computed over all levels
+  static size_t hits();
+  static size_t misses();
+
+ private:
+  /// the cached form of 'poly', null if there is none
+  PolynomialRef lookup(const PolynomialRef& poly);
+
+  struct Entry {
+    std::weak_ptr<const Polynomial> poly;  // expires if the address is reused
+    PolynomialRef reduced;
+  };
+
+  Substitution subs_;
+  std::shared_ptr<SubstitutionLevel> parent_;  // null if substituting from scratch
+  Var var_ = 0;                                // added to the parent's substitution
+  int value_ = 0;
+
+  std::mutex mutex_;
+  std::unordered_map<const Polynomial*, Entry> cache_;
+
+  static std::atomic<size_t> hits_;
+  static std::atomic<size_t> misses_;
+};
+
+/*------------------------------------------------------------------------*/
+#endif  // PACHECK2_SRC_SUBSTITUTION_H_
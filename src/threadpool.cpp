@@ -0,0 +1,126 @@
+/*------------------------------------------------------------------------*/
+/*! \file threadpool.cpp
+    \brief work-stealing thread pool
+
+  Part of Pacheck 3.0 : PAC proof checker.
+*/
+/*------------------------------------------------------------------------*/
+#include "threadpool.h"
+/*------------------------------------------------------------------------*/
+/// the pool the current thread works for, null outside of pools, and
+/// the index of its queue there
+static thread_local const ThreadPool* worker_pool = nullptr;
+static thread_local int worker_index = -1;
+
+/// the queue of the current thread in 'pool', -1 if it works for none
+/// or for another pool, e.g. running a check for a batch of proofs
+static int ownQueue(const ThreadPool* pool) { return worker_pool == pool ? worker_index : -1; }
+/*------------------------------------------------------------------------*/
+
+ThreadPool::ThreadPool(unsigned threads) {
+  if (threads == 0) threads = 1;
+  for (unsigned i = 0; i < threads; ++i) queues_.emplace_back(new Queue);
+  for (unsigned i = 0; i < threads; ++i) {
+    threads_.emplace_back(&ThreadPool::workerLoop, this, i);
+  }
+}
+
+ThreadPool::~ThreadPool() {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    stop_ = true;
+  }
+  work_cond_.notify_all();
+  for (std::thread& t : threads_) t.join();
+}
+
+void ThreadPool::submit(std::function<void()> task) {
+  const int own = ownQueue(this);
+  unsigned q = own >= 0 ? own : next_queue_++ % queues_.size();
+  {
+    std::lock_guard<std::mutex> lock(queues_[q]->mutex);
+    queues_[q]->tasks.push_back(std::move(task));
+  }
+  queued_++;
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+  }
+  work_cond_.notify_one();
+}
+
+/// runs one task, preferring the own queue, returns false if none is queued
+bool ThreadPool::runOne(unsigned self) {
+  std::function<void()> task;
+  const unsigned n = static_cast<unsigned>(queues_.size());
+  for (unsigned k = 0; k < n && !task; ++k) {
+    Queue& q = *queues_[(self + k) % n];
+    std::lock_guard<std::mutex> lock(q.mutex);
+    if (q.tasks.empty()) continue;
+    if (k == 0) {
+      task = std::move(q.tasks.back());
+      q.tasks.pop_back();
+    } else {
+      task = std::move(q.tasks.front());
+      q.tasks.pop_front();
+    }
+  }
+  if (!task) return false;
+
+  queued_--;
+  task();
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+  }
+  done_cond_.notify_all();
+  return true;
+}
+
+void ThreadPool::workerLoop(unsigned index) {
+  worker_pool = this;
+  worker_index = static_cast<int>(index);
+  while (!stop_) {
+    if (runOne(index)) continue;
+    std::unique_lock<std::mutex> lock(mutex_);
+    work_cond_.wait(lock, [this] { return stop_ || queued_ > 0; });
+  }
+}
+
+void ThreadPool::parallelFor(size_t n, const std::function<void(size_t)>& body) {
+  if (n == 0) return;
+  std::atomic<size_t> remaining(n);
+  std::mutex error_mutex;
+  std::exception_ptr error;  // the first one thrown
+  auto fail = [&error_mutex, &error] {
+    std::lock_guard<std::mutex> lock(error_mutex);
+    if (!error) error = std::current_exception();
+  };
+  // the tasks refer to this frame, which is left once all of them ran
+  auto run = [&body, &remaining, &fail](size_t i) {
+    try {
+      body(i);
+    } catch (...) {
+      fail();
+    }
+    remaining.fetch_sub(1, std::memory_order_acq_rel);
+  };
+  size_t submitted = 1;
+  try {
+    for (; submitted < n; ++submitted) submit([&run, submitted] { run(submitted); });
+  } catch (...) {
+    fail();
+    remaining.fetch_sub(n - submitted, std::memory_order_acq_rel);
+  }
+  run(0);
+  helpUntil([&remaining] { return remaining.load(std::memory_order_acquire) == 0; });
+  if (error) std::rethrow_exception(error);
+}
+
+void ThreadPool::helpUntil(const std::function<bool()>& done) {
+  const int own = ownQueue(this);
+  const unsigned self = own >= 0 ? own : 0;
+  while (!done()) {
+    if (runOne(self)) continue;
+    std::unique_lock<std::mutex> lock(mutex_);
+    done_cond_.wait(lock, [&] { return queued_ > 0 || done(); });
+  }
+}
@@ -0,0 +1,68 @@
+/*------------------------------------------------------------------------*/
+/*! \file threadpool.h
+    \brief work-stealing thread pool
+
+  Every worker owns a task queue. Workers pop their own tasks in LIFO
+  order and steal from the other queues in FIFO order when they run dry.
+  Threads waiting for a result help executing tasks instead of blocking.
+  Tasks must not throw, since a helping thread runs tasks of others;
+  parallelFor passes exceptions of its bodies on to the caller.
+
+  Part of Pacheck 3.0 : PAC proof checker.
+*/
+/*------------------------------------------------------------------------*/
+#ifndef PACHECK2_SRC_THREADPOOL_H_
+#define PACHECK2_SRC_THREADPOOL_H_
+/*------------------------------------------------------------------------*/
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+/*------------------------------------------------------------------------*/
+
+class ThreadPool {
+ public:
+  explicit ThreadPool(unsigned threads);
+  /// waits for running tasks, queued ones are dropped
+  ~ThreadPool();
+
+  unsigned size() const { return static_cast<unsigned>(threads_.size()); }
+
+  /// queues 'task', on the own queue if called from a worker, which
+  /// must catch its exceptions and hand them to whoever waits for it
+  void submit(std::function<void()> task);
+
+  /// executes queued tasks on the calling thread until 'done' holds
+  void helpUntil(const std::function<bool()>& done);
+
+  /// runs body(0), ..., body(n - 1) as tasks and waits for all of them,
+  /// then rethrows the first exception thrown by a body, if any
+  void parallelFor(size_t n, const std::function<void(size_t)>& body);
+
+ private:
+  struct Queue {
+    std::mutex mutex;
+    std::deque<std::function<void()>> tasks;
+  };
+
+  bool runOne(unsigned self);
+  void workerLoop(unsigned index);
+
+  std::vector<std::unique_ptr<Queue>> queues_;
+  std::vector<std::thread> threads_;
+  std::atomic<size_t> queued_{0};
+  std::atomic<unsigned> next_queue_{0};
+
+  std::mutex mutex_;
+  std::condition_variable work_cond_;  // signals new tasks
+  std::condition_variable done_cond_;  // signals finished tasks
+  std::atomic<bool> stop_{false};
+};
+
+/*------------------------------------------------------------------------*/
+#endif  // PACHECK2_SRC_THREADPOOL_H_